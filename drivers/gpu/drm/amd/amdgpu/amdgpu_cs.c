@@ -549,8 +549,8 @@ static int amdgpu_cs_parser_bos(struct amdgpu_cs_parser *p,
 		struct list_head need_pages;
 		unsigned i;
 
-		r = ttm_eu_reserve_buffers(&p->ticket, &p->validated, true,
-					   &duplicates);
+		r = ttm_eu_reserve_buffers_sorted(&p->ticket, &p->validated,
+						  true, &duplicates);
 		if (unlikely(r != 0)) {
 			if (r != -ERESTARTSYS)
 				DRM_ERROR("ttm_eu_reserve_buffers failed.\n");
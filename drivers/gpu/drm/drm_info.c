@@ -156,3 +156,26 @@ int drm_gem_name_info(struct seq_file *m, void *data)
 
 	return 0;
 }
+
+/**
+ * Called when "/sys/kernel/debug/dri/.../prime" is read.
+ *
+ * Prints the hit rate of the per-attachment dma-buf mapping cache. Every hit
+ * saves a get_sg_table and a dma_map_sg call.
+ */
+int drm_prime_info(struct seq_file *m, void *data)
+{
+	struct drm_info_node *node = (struct drm_info_node *) m->private;
+	struct drm_device *dev = node->minor->dev;
+	unsigned int hits = atomic_read(&dev->prime_map_hits);
+	unsigned int misses = atomic_read(&dev->prime_map_misses);
+
+	seq_printf(m, "map hits: %u\n", hits);
+	seq_printf(m, "map misses: %u\n", misses);
+	seq_printf(m, "hit rate: %u%%\n",
+		   hits + misses ? (unsigned int)div_u64(100ULL * hits,
+							 hits + misses) : 0);
+	seq_printf(m, "saved map calls: %u\n", 2 * hits);
+
+	return 0;
+}
@@ -53,6 +53,7 @@ void drm_minor_release(struct drm_minor *minor);
 int drm_name_info(struct seq_file *m, void *data);
 int drm_clients_info(struct seq_file *m, void* data);
 int drm_gem_name_info(struct seq_file *m, void *data);
+int drm_prime_info(struct seq_file *m, void *data);
 
 /* drm_vblank.c */
 void drm_vblank_disable_and_save(struct drm_device *dev, unsigned int pipe);
@@ -83,9 +83,14 @@ struct drm_prime_member {
 	struct rb_node handle_rb;
 };
 
+/*
+ * Mappings are cached per attachment and per direction until detach, so that
+ * importers mapping and unmapping the same buffer every frame only pay for
+ * get_sg_table and dma_map_sg once. A bidirectional mapping serves requests
+ * for either direction.
+ */
 struct drm_prime_attachment {
-	struct sg_table *sgt;
-	enum dma_data_direction dir;
+	struct sg_table *sgt[DMA_NONE];
 };
 
 static int drm_prime_add_buf_handle(struct drm_prime_file_private *prime_fpriv,
@@ -192,7 +197,6 @@ static int drm_gem_map_attach(struct dma_buf *dma_buf,
 	if (!prime_attach)
 		return -ENOMEM;
 
-	prime_attach->dir = DMA_NONE;
 	attach->priv = prime_attach;
 
 	if (!dev->driver->gem_prime_pin)
@@ -208,6 +212,7 @@ static void drm_gem_map_detach(struct dma_buf *dma_buf,
 	struct drm_gem_object *obj = dma_buf->priv;
 	struct drm_device *dev = obj->dev;
 	struct sg_table *sgt;
+	int dir;
 
 	if (dev->driver->gem_prime_unpin)
 		dev->driver->gem_prime_unpin(obj);
@@ -215,20 +220,21 @@ static void drm_gem_map_detach(struct dma_buf *dma_buf,
 	if (!prime_attach)
 		return;
 
-	sgt = prime_attach->sgt;
-	if (sgt) {
-		if (prime_attach->dir != DMA_NONE)
+	for (dir = 0; dir < ARRAY_SIZE(prime_attach->sgt); dir++) {
+		sgt = prime_attach->sgt[dir];
+		if (!sgt)
+			continue;
+
 #ifdef __linux__
-			// This function does nothing and linuxkpi's
-			// dma_attrs is old and incompatible
-			dma_unmap_sg_attrs(attach->dev, sgt->sgl, sgt->nents,
-					   prime_attach->dir,
-					   DMA_ATTR_SKIP_CPU_SYNC);
+		// This function does nothing and linuxkpi's
+		// dma_attrs is old and incompatible
+		dma_unmap_sg_attrs(attach->dev, sgt->sgl, sgt->nents, dir,
+				   DMA_ATTR_SKIP_CPU_SYNC);
 #endif
 		sg_free_table(sgt);
+		kfree(sgt);
 	}
 
-	kfree(sgt);
 	kfree(prime_attach);
 	attach->priv = NULL;
 }
@@ -269,16 +275,15 @@ static struct sg_table *drm_gem_map_dma_buf(struct dma_buf_attachment *attach,
 		return ERR_PTR(-EINVAL);
 
 	/* return the cached mapping when possible */
-	if (prime_attach->dir == dir)
-		return prime_attach->sgt;
-
-	/*
-	 * two mappings with different directions for the same attachment are
-	 * not allowed
-	 */
-	if (WARN_ON(prime_attach->dir != DMA_NONE))
-		return ERR_PTR(-EBUSY);
+	sgt = prime_attach->sgt[DMA_BIDIRECTIONAL];
+	if (!sgt)
+		sgt = prime_attach->sgt[dir];
+	if (sgt) {
+		atomic_inc(&obj->dev->prime_map_hits);
+		return sgt;
+	}
 
+	atomic_inc(&obj->dev->prime_map_misses);
 	sgt = obj->dev->driver->gem_prime_get_sg_table(obj);
 
 	if (!IS_ERR(sgt)) {
@@ -293,8 +298,7 @@ static struct sg_table *drm_gem_map_dma_buf(struct dma_buf_attachment *attach,
 			kfree(sgt);
 			sgt = ERR_PTR(-ENOMEM);
 		} else {
-			prime_attach->sgt = sgt;
-			prime_attach->dir = dir;
+			prime_attach->sgt[dir] = sgt;
 		}
 	}
 
@@ -807,6 +811,8 @@ int drm_prime_fd_to_handle_ioctl(struct drm_device *dev, void *data,
  * This helper creates an sg table object from a set of pages
  * the driver is responsible for mapping the pages into the
  * importers address space for use with dma_buf itself.
+ *
+ * Runs of physically contiguous pages are coalesced into a single sg entry.
  */
 struct sg_table *drm_prime_pages_to_sg(struct page **pages, unsigned int nr_pages)
 {
@@ -840,6 +846,10 @@ EXPORT_SYMBOL(drm_prime_pages_to_sg);
  *
  * Exports an sg table into an array of pages and addresses. This is currently
  * required by the TTM driver in order to do correct fault handling.
+ *
+ * Each sg entry is expanded as a whole: the bounds are checked once per entry
+ * and the page and address arrays are then filled with simple strided loops,
+ * so large, coalesced entries cost little more than a memset.
  */
 int drm_prime_sg_to_page_addr_arrays(struct sg_table *sgt, struct page **pages,
 				     dma_addr_t *addrs, int max_pages)
@@ -847,28 +857,27 @@ int drm_prime_sg_to_page_addr_arrays(struct sg_table *sgt, struct page **pages,
 	unsigned count;
 	struct scatterlist *sg;
 	struct page *page;
-	u32 len;
+	unsigned int i, npages;
 	int pg_index;
 	dma_addr_t addr;
 
 	pg_index = 0;
 	for_each_sg(sgt->sgl, sg, sgt->nents, count) {
-		len = sg->length;
+		npages = DIV_ROUND_UP(sg->length, PAGE_SIZE);
+		if (WARN_ON(npages > max_pages - pg_index))
+			return -1;
+
 		page = sg_page(sg);
-		addr = sg_dma_address(sg);
-
-		while (len > 0) {
-			if (WARN_ON(pg_index >= max_pages))
-				return -1;
-			pages[pg_index] = page;
-			if (addrs)
-				addrs[pg_index] = addr;
-
-			page++;
-			addr += PAGE_SIZE;
-			len -= PAGE_SIZE;
-			pg_index++;
+		for (i = 0; i < npages; i++)
+			pages[pg_index + i] = page + i;
+
+		if (addrs) {
+			addr = sg_dma_address(sg);
+			for (i = 0; i < npages; i++)
+				addrs[pg_index + i] = addr + i * PAGE_SIZE;
 		}
+
+		pg_index += npages;
 	}
 	return 0;
 }
@@ -424,7 +424,9 @@ static int i915_gem_object_info(struct seq_file *m, void *data)
 	struct i915_ggtt *ggtt = &dev_priv->ggtt;
 	u32 count, mapped_count, purgeable_count, dpy_count, huge_count;
 	u64 size, mapped_size, purgeable_size, dpy_size, huge_size;
+	unsigned long pin_fast, pin_slow;
 	struct drm_i915_gem_object *obj;
+	struct i915_address_space *vm;
 	unsigned int page_sizes = 0;
 	struct drm_file *file;
 	char buf[80];
@@ -513,6 +515,15 @@ static int i915_gem_object_info(struct seq_file *m, void *data)
 		   stringify_page_sizes(INTEL_INFO(dev_priv)->page_sizes,
 					buf, sizeof(buf)));
 
+	pin_fast = pin_slow = 0;
+	list_for_each_entry(vm, &dev_priv->vm_list, global_link) {
+		pin_fast += vm->pin_stats.fast;
+		pin_slow += vm->pin_stats.slow;
+	}
+	seq_printf(m, "%lu fast vma pins, %lu slow (GGTT: %lu fast, %lu slow)\n",
+		   pin_fast, pin_slow,
+		   ggtt->base.pin_stats.fast, ggtt->base.pin_stats.slow);
+
 	seq_putc(m, '\n');
 	print_batch_pool_stats(m, dev_priv);
 	mutex_unlock(&dev->struct_mutex);
@@ -864,6 +875,7 @@ static int i915_interrupt_info(struct seq_file *m, void *data)
 static int i915_gem_fence_regs_info(struct seq_file *m, void *data)
 {
 	struct drm_i915_private *dev_priv = node_to_i915(m->private);
+	const struct i915_fence_stats *stats = &dev_priv->mm.fence_stats;
 	struct drm_device *dev = &dev_priv->drm;
 	int i, ret;
 
@@ -872,6 +884,8 @@ static int i915_gem_fence_regs_info(struct seq_file *m, void *data)
 		return ret;
 
 	seq_printf(m, "Total fences = %d\n", dev_priv->num_fence_regs);
+	seq_printf(m, "Hits = %lu, misses = %lu, steals = %lu, revokes = %lu\n",
+		   stats->hits, stats->misses, stats->steals, stats->revokes);
 	for (i = 0; i < dev_priv->num_fence_regs; i++) {
 		struct i915_vma *vma = dev_priv->fence_regs[i].vma;
 
@@ -881,6 +895,9 @@ static int i915_gem_fence_regs_info(struct seq_file *m, void *data)
 			seq_puts(m, "unused");
 		else
 			describe_obj(m, vma->obj);
+		if (vma && vma->obj->fence_steals)
+			seq_printf(m, " (recently stolen %u times)",
+				   vma->obj->fence_steals);
 		seq_putc(m, '\n');
 	}
 
@@ -905,6 +922,7 @@ static ssize_t gpu_state_read(struct file *file, char __user *ubuf,
 	if (ret)
 		return ret;
 
+	i915_gpu_state_wait(error);
 	ret = i915_error_state_to_str(&str, error);
 	if (ret)
 		goto out;
@@ -1003,6 +1021,7 @@ static int gpu_state_read(struct seq_file *m, void *unused)
 	if (ret)
 		return ret;
 
+	i915_gpu_state_wait(gpu);
 	ret = i915_error_state_to_str(&str, gpu);
 	if (ret)
 		goto out;
@@ -455,6 +455,8 @@ struct intel_display_error_state;
 
 struct i915_gpu_state {
 	struct kref ref;
+	struct completion compressed;
+	atomic_t pending;
 	struct timeval time;
 	struct timeval boottime;
 	struct timeval uptime;
@@ -1092,9 +1094,17 @@ struct i915_gem_mm {
 	spinlock_t free_lock;
 
 	/**
-	 * Small stash of WC pages
+	 * Small stash of WC pages, shared by all address spaces and kept
+	 * topped up by wc_stash_work.
 	 */
-	struct pagevec wc_stash;
+	struct pagestash wc_stash;
+	struct work_struct wc_stash_work;
+
+	/**
+	 * Number of unused page tables cached across all address spaces,
+	 * see i915_address_space.pt_cache. Guarded by struct_mutex.
+	 */
+	unsigned long pt_cache_count;
 
 	/**
 	 * tmpfs instance used for shmem backed objects
@@ -1108,8 +1118,16 @@ struct i915_gem_mm {
 	struct notifier_block vmap_notifier;
 	struct shrinker shrinker;
 
+	/**
+	 * Pages the shrinker has asked for but that direct reclaim left
+	 * for @shrink_work to release, see i915_gem_shrinker_scan().
+	 */
+	atomic_long_t shrink_pending;
+	struct work_struct shrink_work;
+
 	/** LRU list of objects with fence regs on them. */
 	struct list_head fence_list;
+	struct i915_fence_stats fence_stats;
 
 	/**
 	 * Workqueue to fault in userptr pages, flushed by the execbuf
@@ -2350,6 +2368,13 @@ struct drm_i915_private {
 		 */
 		struct delayed_work idle_work;
 
+		/**
+		 * Set before the engines are freed, after which released
+		 * requests bypass the per-engine pools and go straight back
+		 * to the slab. See i915_gem_request_pools_close().
+		 */
+		bool request_pools_closed;
+
 		ktime_t last_init_time;
 	} gt;
 
@@ -3361,6 +3386,8 @@ struct drm_i915_gem_request *
 i915_gem_find_active_request(struct intel_engine_cs *engine);
 
 void i915_gem_retire_requests(struct drm_i915_private *dev_priv);
+void i915_gem_queue_retire(struct intel_engine_cs *engine);
+void i915_gem_engine_retire_work_handler(struct work_struct *work);
 
 static inline bool i915_reset_backoff(struct i915_gpu_error *error)
 {
@@ -3582,6 +3609,7 @@ unsigned long i915_gem_shrink(struct drm_i915_private *i915,
 #define I915_SHRINK_BOUND 0x4
 #define I915_SHRINK_ACTIVE 0x8
 #define I915_SHRINK_VMAPS 0x10
+#define I915_SHRINK_LARGE 0x20
 unsigned long i915_gem_shrink_all(struct drm_i915_private *i915);
 void i915_gem_shrinker_register(struct drm_i915_private *i915);
 void i915_gem_shrinker_unregister(struct drm_i915_private *i915);
@@ -3648,6 +3676,13 @@ static inline void i915_gpu_state_put(struct i915_gpu_state *gpu)
 		kref_put(&gpu->ref, __i915_gpu_state_free);
 }
 
+/* Wait for the captured objects to be compressed, before printing them */
+static inline void i915_gpu_state_wait(struct i915_gpu_state *gpu)
+{
+	if (gpu)
+		wait_for_completion(&gpu->compressed);
+}
+
 struct i915_gpu_state *i915_first_error_state(struct drm_i915_private *i915);
 void i915_reset_error_state(struct drm_i915_private *i915);
 
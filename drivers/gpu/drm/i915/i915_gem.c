@@ -519,6 +519,7 @@ i915_gem_object_wait_priority(struct drm_i915_gem_object *obj,
 			      unsigned int flags,
 			      int prio)
 {
+#ifdef __linux__
 	struct dma_fence *excl;
 
 	if (flags & I915_WAIT_ALL) {
@@ -546,6 +547,18 @@ i915_gem_object_wait_priority(struct drm_i915_gem_object *obj,
 		dma_fence_put(excl);
 	}
 	return 0;
+#else
+	struct reservation_object_iter it;
+	struct dma_fence *fence;
+
+	/* bumping the priority twice after a restart is harmless */
+	reservation_object_iter_begin(&it, obj->resv, flags & I915_WAIT_ALL);
+	reservation_object_for_each_fence_unlocked(&it, fence)
+		fence_set_priority(fence, prio);
+	reservation_object_iter_end(&it);
+
+	return 0;
+#endif
 }
 
 /**
@@ -1957,6 +1970,69 @@ compute_partial_view(struct drm_i915_gem_object *obj,
 	return view;
 }
 
+/*
+ * Service the fault by remapping the view we last faulted in for this
+ * object, without taking struct_mutex. This is only possible while that
+ * view is still mapped into userspace (revoking the mmap clears
+ * obj->userfault_vma under the userfault_lock, and must happen before the
+ * vma can be unbound or lose its fence) and needs no domain change.
+ * Anything else returns -EAGAIN for the slow path.
+ */
+static int i915_gem_fault_fast(struct drm_i915_gem_object *obj,
+			       struct vm_area_struct *area,
+			       pgoff_t page_offset,
+			       bool write)
+{
+	struct drm_i915_private *i915 = to_i915(obj->base.dev);
+	struct i915_ggtt *ggtt = &i915->ggtt;
+	struct i915_vma *vma;
+	int ret;
+
+	if (!READ_ONCE(obj->userfault_vma))
+		return -EAGAIN;
+
+	ret = mutex_lock_interruptible(&obj->userfault_lock);
+	if (ret)
+		return ret;
+
+	ret = -EAGAIN;
+	vma = obj->userfault_vma;
+	if (!vma)
+		goto out;
+
+	GEM_BUG_ON(!i915_vma_has_userfault(vma));
+	GEM_BUG_ON(!drm_mm_node_allocated(&vma->node));
+
+	if (vma->ggtt_view.type == I915_GGTT_VIEW_PARTIAL &&
+	    (page_offset < vma->ggtt_view.partial.offset ||
+	     page_offset >= vma->ggtt_view.partial.offset +
+			    vma->ggtt_view.partial.size))
+		goto out;
+
+	if (obj->cache_level != I915_CACHE_NONE && !HAS_LLC(i915))
+		goto out;
+
+	if (!(READ_ONCE(obj->base.read_domains) & I915_GEM_DOMAIN_GTT))
+		goto out;
+
+	if (write && READ_ONCE(obj->base.write_domain) != I915_GEM_DOMAIN_GTT)
+		goto out;
+
+	/* Marking the vma as written through the GGTT needs struct_mutex */
+	if (!i915_vma_has_ggtt_write(vma))
+		goto out;
+
+	ret = remap_io_mapping(area,
+			       area->vm_start + (vma->ggtt_view.partial.offset << PAGE_SHIFT),
+			       (ggtt->gmadr.start + vma->node.start) >> PAGE_SHIFT,
+			       min_t(u64, vma->size, area->vm_end - area->vm_start),
+			       &ggtt->iomap);
+
+out:
+	mutex_unlock(&obj->userfault_lock);
+	return ret;
+}
+
 /**
  * i915_gem_fault - fault a page into the GTT
  * @vmf: fault info
@@ -1982,6 +2058,7 @@ int i915_gem_fault(struct vm_area_struct *dummy, struct vm_fault *vmf)
 #endif
 {
 #define MIN_CHUNK_PAGES ((1 << 20) >> PAGE_SHIFT) /* 1 MiB */
+#define MAX_CHUNK_PAGES ((8 << 20) >> PAGE_SHIFT) /* 8 MiB */
 	struct vm_area_struct *area = vmf->vma;
 	struct drm_i915_gem_object *obj = to_intel_bo(area->vm_private_data);
 	struct drm_device *dev = obj->base.dev;
@@ -2020,6 +2097,10 @@ int i915_gem_fault(struct vm_area_struct *dummy, struct vm_fault *vmf)
 
 	intel_runtime_pm_get(dev_priv);
 
+	ret = i915_gem_fault_fast(obj, area, page_offset, write);
+	if (ret != -EAGAIN)
+		goto err_rpm;
+
 	ret = i915_mutex_lock_interruptible(dev);
 	if (ret)
 		goto err_rpm;
@@ -2040,6 +2121,20 @@ int i915_gem_fault(struct vm_area_struct *dummy, struct vm_fault *vmf)
 
 	/* Now pin it into the GTT as needed */
 	vma = i915_gem_object_ggtt_pin(obj, NULL, 0, 0, flags);
+	if (IS_ERR(vma) && obj->base.size > MAX_CHUNK_PAGES << PAGE_SHIFT) {
+		/* Fault around: the whole view is remapped below, so try
+		 * for a larger one first, if it fits without a fight.
+		 */
+		struct i915_ggtt_view view =
+			compute_partial_view(obj, page_offset, MAX_CHUNK_PAGES);
+
+		obj->frontbuffer_ggtt_origin = ORIGIN_CPU;
+
+		vma = i915_gem_object_ggtt_pin(obj, &view, 0, 0,
+					       PIN_MAPPABLE |
+					       PIN_NONBLOCK |
+					       PIN_NONFAULT);
+	}
 	if (IS_ERR(vma)) {
 		/* Use a partial view if it is bigger than available space */
 		struct i915_ggtt_view view =
@@ -2082,6 +2177,11 @@ int i915_gem_fault(struct vm_area_struct *dummy, struct vm_fault *vmf)
 
 	i915_vma_set_ggtt_write(vma);
 
+	/* Let further faults upon this view skip struct_mutex */
+	mutex_lock(&obj->userfault_lock);
+	obj->userfault_vma = vma;
+	mutex_unlock(&obj->userfault_lock);
+
 err_fence:
 	i915_vma_unpin_fence(vma);
 err_unpin:
@@ -2141,6 +2241,9 @@ static void __i915_gem_object_release_mmap(struct drm_i915_gem_object *obj)
 
 	GEM_BUG_ON(!obj->userfault_count);
 
+	mutex_lock(&obj->userfault_lock);
+	obj->userfault_vma = NULL;
+
 	obj->userfault_count = 0;
 	list_del(&obj->userfault_link);
 
@@ -2156,6 +2259,8 @@ static void __i915_gem_object_release_mmap(struct drm_i915_gem_object *obj)
 #endif
 	for_each_ggtt_vma(vma, obj)
 		i915_vma_unset_userfault(vma);
+
+	mutex_unlock(&obj->userfault_lock);
 }
 
 /**
@@ -3468,7 +3573,14 @@ i915_gem_retire_work_handler(struct work_struct *work)
 
 	/* Come back later if the device is busy... */
 	if (mutex_trylock(&dev->struct_mutex)) {
+		struct intel_engine_cs *engine;
+		enum intel_engine_id id;
+
 		i915_gem_retire_requests(dev_priv);
+
+		for_each_engine(engine, dev_priv, id)
+			i915_gem_batch_pool_trim(&engine->batch_pool);
+
 		mutex_unlock(&dev->struct_mutex);
 	}
 
@@ -3586,6 +3698,8 @@ void i915_gem_close_object(struct drm_gem_object *gem, struct drm_file *file)
 
 	mutex_lock(&i915->drm.struct_mutex);
 
+	i915_gem_context_close_object(file, obj);
+
 	list_for_each_entry_safe(lut, ln, &obj->lut_list, obj_link) {
 		struct i915_gem_context *ctx = lut->ctx;
 		struct i915_vma *vma;
@@ -3594,7 +3708,7 @@ void i915_gem_close_object(struct drm_gem_object *gem, struct drm_file *file)
 		if (ctx->file_priv != fpriv)
 			continue;
 
-		vma = radix_tree_delete(&ctx->handles_vma, lut->handle);
+		vma = i915_handle_table_remove(&ctx->handles_vma, lut->handle);
 		GEM_BUG_ON(vma->obj != obj);
 
 		/* We allow the process to have multiple handles to the same
@@ -4626,6 +4740,7 @@ void i915_gem_object_init(struct drm_i915_gem_object *obj,
 			  const struct drm_i915_gem_object_ops *ops)
 {
 	mutex_init(&obj->mm.lock);
+	mutex_init(&obj->userfault_lock);
 
 	INIT_LIST_HEAD(&obj->vma_list);
 	INIT_LIST_HEAD(&obj->lut_list);
@@ -5495,6 +5610,8 @@ i915_gem_cleanup_engines(struct drm_i915_private *dev_priv)
 	struct intel_engine_cs *engine;
 	enum intel_engine_id id;
 
+	i915_gem_request_pools_close(dev_priv);
+
 	for_each_engine(engine, dev_priv, id)
 		dev_priv->gt.cleanup_engine(engine);
 }
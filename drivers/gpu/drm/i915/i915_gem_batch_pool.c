@@ -39,6 +39,12 @@
  * extended to support other uses cases should they arise.
  */
 
+/*
+ * Once the pool holds more than this, the idle objects are released
+ * by i915_gem_batch_pool_trim() (oldest first).
+ */
+#define I915_GEM_BATCH_POOL_WATERMARK (8ull << 20)
+
 /**
  * i915_gem_batch_pool_init() - initialize a batch buffer pool
  * @engine: the associated request submission engine
@@ -50,6 +56,7 @@ void i915_gem_batch_pool_init(struct intel_engine_cs *engine,
 	int n;
 
 	pool->engine = engine;
+	pool->size = 0;
 
 	for (n = 0; n < ARRAY_SIZE(pool->cache_list); n++)
 		INIT_LIST_HEAD(&pool->cache_list[n]);
@@ -77,6 +84,45 @@ void i915_gem_batch_pool_fini(struct i915_gem_batch_pool *pool)
 
 		INIT_LIST_HEAD(&pool->cache_list[n]);
 	}
+
+	pool->size = 0;
+}
+
+/**
+ * i915_gem_batch_pool_trim() - release idle buffers above the watermark
+ * @pool: the pool to trim
+ *
+ * Releases the least recently used idle buffers from @pool until it holds
+ * no more than I915_GEM_BATCH_POOL_WATERMARK bytes, or only busy buffers
+ * remain. Called periodically from the retire worker, so that a burst of
+ * large batches does not leave the pool holding on to memory indefinitely.
+ *
+ * Note: Callers must hold the struct_mutex.
+ */
+void i915_gem_batch_pool_trim(struct i915_gem_batch_pool *pool)
+{
+	int n;
+
+	lockdep_assert_held(&pool->engine->i915->drm.struct_mutex);
+
+	/* Start with the largest buckets, they free the most memory */
+	for (n = ARRAY_SIZE(pool->cache_list); n--; ) {
+		struct drm_i915_gem_object *obj, *next;
+
+		list_for_each_entry_safe(obj, next,
+					 &pool->cache_list[n],
+					 batch_pool_link) {
+			if (pool->size <= I915_GEM_BATCH_POOL_WATERMARK)
+				return;
+
+			if (i915_gem_object_is_active(obj))
+				continue;
+
+			list_del_init(&obj->batch_pool_link);
+			pool->size -= obj->base.size;
+			__i915_gem_object_release_unless_active(obj);
+		}
+	}
 }
 
 /**
@@ -103,8 +149,8 @@ i915_gem_batch_pool_get(struct i915_gem_batch_pool *pool,
 	lockdep_assert_held(&pool->engine->i915->drm.struct_mutex);
 
 	/* Compute a power-of-two bucket, but throw everything greater than
-	 * 16KiB into the same bucket: i.e. the the buckets hold objects of
-	 * (1 page, 2 pages, 4 pages, 8+ pages).
+	 * 128MiB into the same bucket: i.e. the the buckets hold objects of
+	 * (1 page, 2-3 pages, 4-7 pages, ..., 32768+ pages).
 	 */
 	n = fls(size >> PAGE_SHIFT) - 1;
 	if (n >= ARRAY_SIZE(pool->cache_list))
@@ -112,12 +158,20 @@ i915_gem_batch_pool_get(struct i915_gem_batch_pool *pool,
 	list = &pool->cache_list[n];
 
 	list_for_each_entry(obj, list, batch_pool_link) {
-		/* The batches are strictly LRU ordered */
+		if (obj->base.size < size)
+			continue;
+
+		/*
+		 * The batches are LRU ordered, but as they may be used on
+		 * different timelines, an older batch may still be busy when
+		 * a younger one is already idle. Skip over the busy ones
+		 * rather than give up and allocate a fresh object.
+		 */
 		if (i915_gem_object_is_active(obj)) {
 			struct reservation_object *resv = obj->resv;
 
 			if (!reservation_object_test_signaled_rcu(resv, true))
-				break;
+				continue;
 
 			i915_gem_retire_requests(pool->engine->i915);
 			GEM_BUG_ON(i915_gem_object_is_active(obj));
@@ -139,9 +193,7 @@ i915_gem_batch_pool_get(struct i915_gem_batch_pool *pool,
 
 		GEM_BUG_ON(!reservation_object_test_signaled_rcu(obj->resv,
 								 true));
-
-		if (obj->base.size >= size)
-			goto found;
+		goto found;
 	}
 
 	obj = i915_gem_object_create_internal(pool->engine->i915, size);
@@ -153,6 +205,8 @@ found:
 	if (ret)
 		return ERR_PTR(ret);
 
+	if (list_empty(&obj->batch_pool_link))
+		pool->size += obj->base.size;
 	list_move_tail(&obj->batch_pool_link, list);
 	return obj;
 }
@@ -31,13 +31,15 @@ struct intel_engine_cs;
 
 struct i915_gem_batch_pool {
 	struct intel_engine_cs *engine;
-	struct list_head cache_list[4];
+	struct list_head cache_list[16];
+	u64 size; /* total size of all objects held in the pool */
 };
 
 /* i915_gem_batch_pool.c */
 void i915_gem_batch_pool_init(struct intel_engine_cs *engine,
 			      struct i915_gem_batch_pool *pool);
 void i915_gem_batch_pool_fini(struct i915_gem_batch_pool *pool);
+void i915_gem_batch_pool_trim(struct i915_gem_batch_pool *pool);
 struct drm_i915_gem_object*
 i915_gem_batch_pool_get(struct i915_gem_batch_pool *pool, size_t size);
 
@@ -22,19 +22,38 @@
  *
  */
 
+#if defined(CONFIG_X86)
+#include <asm/smp.h>
+#endif
+
 #include "i915_drv.h"
 #include "intel_frontbuffer.h"
 #include "i915_gem_clflush.h"
 
+/*
+ * Beyond this many bytes queued for a single pass, it is cheaper to write
+ * back the whole cache with wbinvd than to clflush each line in turn.
+ */
+#define I915_CLFLUSH_WBINVD_THRESHOLD SZ_8M
+
 static DEFINE_SPINLOCK(clflush_lock);
 
 struct clflush {
 	struct dma_fence dma; /* Must be first for dma_fence_free() */
 	struct i915_sw_fence wait;
-	struct work_struct work;
+	struct llist_node link;
 	struct drm_i915_gem_object *obj;
 };
 
+static void i915_clflush_work(struct work_struct *work);
+
+/*
+ * Every asynchronous clflush whose dependencies have completed is placed
+ * upon this list, and a single worker flushes the lot in one pass.
+ */
+static LLIST_HEAD(clflush_list);
+static DECLARE_WORK(clflush_work, i915_clflush_work);
+
 static const char *i915_clflush_get_driver_name(struct dma_fence *fence)
 {
 	return DRIVER_NAME;
@@ -75,25 +94,61 @@ static void __i915_do_clflush(struct drm_i915_gem_object *obj)
 	intel_fb_obj_flush(obj, ORIGIN_CPU);
 }
 
-static void i915_clflush_work(struct work_struct *work)
+static bool i915_clflush_wbinvd(u64 size)
 {
-	struct clflush *clflush = container_of(work, typeof(*clflush), work);
-	struct drm_i915_gem_object *obj = clflush->obj;
+#if defined(CONFIG_X86)
+	if (size >= I915_CLFLUSH_WBINVD_THRESHOLD)
+		return wbinvd_on_all_cpus() == 0;
+#endif
+	return false;
+}
 
-	if (i915_gem_object_pin_pages(obj)) {
-		DRM_ERROR("Failed to acquire obj->pages for clflushing\n");
-		goto out;
+static void i915_clflush_work(struct work_struct *work)
+{
+	struct clflush *clflush, *next;
+	struct llist_node *batch;
+	bool flushed;
+	u64 size;
+
+	batch = llist_del_all(&clflush_list);
+	if (!batch)
+		return;
+
+	/* Signal the fences in the order in which they became ready */
+	batch = llist_reverse_order(batch);
+
+	size = 0;
+	llist_for_each_entry(clflush, batch, link) {
+		struct drm_i915_gem_object *obj = clflush->obj;
+
+		if (i915_gem_object_pin_pages(obj)) {
+			DRM_ERROR("Failed to acquire obj->pages for clflushing\n");
+			i915_gem_object_put(obj);
+			clflush->obj = NULL;
+			continue;
+		}
+
+		size += obj->base.size;
 	}
 
-	__i915_do_clflush(obj);
+	flushed = i915_clflush_wbinvd(size);
 
-	i915_gem_object_unpin_pages(obj);
+	llist_for_each_entry_safe(clflush, next, batch, link) {
+		struct drm_i915_gem_object *obj = clflush->obj;
 
-out:
-	i915_gem_object_put(obj);
+		if (obj) {
+			if (flushed)
+				intel_fb_obj_flush(obj, ORIGIN_CPU);
+			else
+				__i915_do_clflush(obj);
 
-	dma_fence_signal(&clflush->dma);
-	dma_fence_put(&clflush->dma);
+			i915_gem_object_unpin_pages(obj);
+			i915_gem_object_put(obj);
+		}
+
+		dma_fence_signal(&clflush->dma);
+		dma_fence_put(&clflush->dma);
+	}
 }
 
 static int __i915_sw_fence_call
@@ -104,7 +159,8 @@ i915_clflush_notify(struct i915_sw_fence *fence,
 
 	switch (state) {
 	case FENCE_COMPLETE:
-		schedule_work(&clflush->work);
+		if (llist_add(&clflush->link, &clflush_list))
+			schedule_work(&clflush_work);
 		break;
 
 	case FENCE_FREE:
@@ -160,7 +216,6 @@ bool i915_gem_clflush_object(struct drm_i915_gem_object *obj,
 		i915_sw_fence_init(&clflush->wait, i915_clflush_notify);
 
 		clflush->obj = i915_gem_object_get(obj);
-		INIT_WORK(&clflush->work, i915_clflush_work);
 
 		dma_fence_get(&clflush->dma);
 
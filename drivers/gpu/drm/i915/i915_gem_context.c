@@ -88,30 +88,166 @@
 #include <linux/log2.h>
 #include <drm/drmP.h>
 #include <drm/i915_drm.h>
+#include <uapi/drm/i915_drm_freebsd.h>
 #include "i915_drv.h"
 #include "i915_trace.h"
 
 #define ALL_L3_SLICES(dev) (1 << NUM_L3_SLICES(dev)) - 1
 
+#define I915_HANDLE_TABLE_MIN_BITS 6
+
+static void handle_table_add(struct i915_handle_slot *slots, unsigned int bits,
+			     u32 handle, struct i915_vma *vma)
+{
+	const unsigned int mask = BIT(bits) - 1;
+	unsigned int i;
+
+	for (i = hash_32(handle, bits); slots[i].vma; i = (i + 1) & mask)
+		;
+
+	slots[i].handle = handle;
+	slots[i].vma = vma;
+}
+
+static int handle_table_grow(struct i915_handle_table *t)
+{
+	unsigned int bits, i;
+	struct i915_handle_slot *slots;
+
+	bits = t->slots ? t->bits + 1 : I915_HANDLE_TABLE_MIN_BITS;
+	slots = kvmalloc_array(BIT(bits), sizeof(*slots), GFP_KERNEL);
+	if (!slots)
+		return -ENOMEM;
+
+	memset(slots, 0, BIT(bits) * sizeof(*slots));
+
+	if (t->slots) {
+		for (i = 0; i < BIT(t->bits); i++) {
+			if (t->slots[i].vma)
+				handle_table_add(slots, bits,
+						 t->slots[i].handle,
+						 t->slots[i].vma);
+		}
+		kvfree(t->slots);
+	}
+
+	t->slots = slots;
+	t->bits = bits;
+	return 0;
+}
+
+/**
+ * i915_handle_table_insert - add a handle to vma mapping
+ * @t: the table
+ * @handle: user handle, must not already be present
+ * @vma: the vma to return from i915_handle_table_lookup()
+ *
+ * Returns 0 on success, -EEXIST if @handle is already present or -ENOMEM
+ * if the table needed to grow and could not.
+ */
+int i915_handle_table_insert(struct i915_handle_table *t,
+			     u32 handle, struct i915_vma *vma)
+{
+	int err;
+
+	GEM_BUG_ON(!vma);
+
+	if (i915_handle_table_lookup(t, handle))
+		return -EEXIST;
+
+	/* Keep at least half the slots empty so that probe runs stay short */
+	if (!t->slots || 2 * (t->count + 1) > BIT(t->bits)) {
+		err = handle_table_grow(t);
+		if (err)
+			return err;
+	}
+
+	handle_table_add(t->slots, t->bits, handle, vma);
+	t->count++;
+	return 0;
+}
+
+/**
+ * i915_handle_table_remove - remove a handle from the table
+ * @t: the table
+ * @handle: user handle
+ *
+ * Returns the vma that @handle mapped to, or NULL if it was not present.
+ */
+struct i915_vma *i915_handle_table_remove(struct i915_handle_table *t,
+					  u32 handle)
+{
+	const unsigned int mask = BIT(t->bits) - 1;
+	struct i915_vma *vma;
+	unsigned int i, j;
+
+	if (!t->slots)
+		return NULL;
+
+	for (i = hash_32(handle, t->bits); t->slots[i].vma; i = (i + 1) & mask) {
+		if (t->slots[i].handle == handle)
+			break;
+	}
+
+	vma = t->slots[i].vma;
+	if (!vma)
+		return NULL;
+
+	/*
+	 * Rather than leave a tombstone, shuffle back any later entry of the
+	 * run that may legitimately live in the hole, i.e. whose home slot
+	 * does not lie between the hole and where it currently sits.
+	 */
+	for (j = (i + 1) & mask; t->slots[j].vma; j = (j + 1) & mask) {
+		unsigned int home = hash_32(t->slots[j].handle, t->bits);
+
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			t->slots[i] = t->slots[j];
+			i = j;
+		}
+	}
+	t->slots[i].vma = NULL;
+
+	t->count--;
+	return vma;
+}
+
 static void lut_close(struct i915_gem_context *ctx)
 {
+	struct i915_handle_table *t = &ctx->handles_vma;
 	struct i915_lut_handle *lut, *ln;
-	struct radix_tree_iter iter;
-	void __rcu **slot;
+	unsigned int i;
 
 	list_for_each_entry_safe(lut, ln, &ctx->handles_list, ctx_link) {
 		list_del(&lut->obj_link);
 		kmem_cache_free(ctx->i915->luts, lut);
 	}
 
-	rcu_read_lock();
-	radix_tree_for_each_slot(slot, &ctx->handles_vma, &iter, 0) {
-		struct i915_vma *vma = rcu_dereference_raw(*slot);
+	for (i = 0; t->slots && i < BIT(t->bits); i++) {
+		struct i915_vma *vma = t->slots[i].vma;
 
-		radix_tree_iter_delete(&ctx->handles_vma, &iter, slot);
-		__i915_gem_object_release_unless_active(vma->obj);
+		if (vma)
+			__i915_gem_object_release_unless_active(vma->obj);
 	}
-	rcu_read_unlock();
+
+	kvfree(t->slots);
+	i915_handle_table_init(t);
+}
+
+static void resident_set_free(struct i915_gem_resident_set *set)
+{
+	unsigned int n;
+
+	if (!set)
+		return;
+
+	for (n = 0; n < set->count; n++) {
+		struct i915_vma *vma = set->entries[n].vma;
+
+		i915_vma_unpin(vma);
+		i915_gem_object_put(vma->obj);
+	}
+	kvfree(set);
 }
 
 static void i915_gem_context_free(struct i915_gem_context *ctx)
@@ -120,6 +256,7 @@ static void i915_gem_context_free(struct i915_gem_context *ctx)
 
 	lockdep_assert_held(&ctx->i915->drm.struct_mutex);
 	GEM_BUG_ON(!i915_gem_context_is_closed(ctx));
+	GEM_BUG_ON(ctx->resident);
 
 	i915_ppgtt_put(ctx->ppgtt);
 
@@ -197,6 +334,9 @@ static void context_close(struct i915_gem_context *ctx)
 {
 	i915_gem_context_set_closed(ctx);
 
+	resident_set_free(ctx->resident);
+	ctx->resident = NULL;
+
 	/*
 	 * The LUT uses the VMA as a backpointer to unref the object,
 	 * so we need to clear the LUT before we close all the VMA (inside
@@ -278,7 +418,7 @@ __create_hw_context(struct drm_i915_private *dev_priv,
 	ctx->i915 = dev_priv;
 	ctx->priority = I915_PRIORITY_NORMAL;
 
-	INIT_RADIX_TREE(&ctx->handles_vma, GFP_KERNEL);
+	i915_handle_table_init(&ctx->handles_vma);
 	INIT_LIST_HEAD(&ctx->handles_list);
 
 	/* Default context will never have a file_priv */
@@ -572,6 +712,59 @@ void i915_gem_context_close(struct drm_file *file)
 	idr_destroy(&file_priv->context_idr);
 }
 
+static int context_idr_close_object(int id, void *p, void *data)
+{
+	struct i915_gem_context *ctx = p;
+	struct drm_i915_gem_object *obj = data;
+	struct i915_gem_resident_set *set = ctx->resident;
+	unsigned int n;
+
+	if (!set)
+		return 0;
+
+	n = 0;
+	while (n < set->count) {
+		struct i915_vma *vma = set->entries[n].vma;
+
+		if (vma->obj != obj) {
+			n++;
+			continue;
+		}
+
+		set->entries[n] = set->entries[--set->count];
+		i915_vma_unpin(vma);
+		i915_gem_object_put(obj);
+	}
+
+	return 0;
+}
+
+/**
+ * i915_gem_context_close_object - drop a closed object from resident sets
+ * @file: drm file private
+ * @obj: object whose handle is being closed
+ *
+ * Called from i915_gem_close_object() before the vma of @obj are closed, so
+ * that no resident set of @file keeps one of them pinned.
+ */
+void i915_gem_context_close_object(struct drm_file *file,
+				   struct drm_i915_gem_object *obj)
+{
+	struct drm_i915_file_private *file_priv = file->driver_priv;
+	struct i915_vma *vma;
+
+	lockdep_assert_held(&obj->base.dev->struct_mutex);
+
+	/* A resident set keeps its vma pinned; skip the walk if none are */
+	list_for_each_entry(vma, &obj->vma_list, obj_link) {
+		if (i915_vma_is_pinned(vma)) {
+			idr_for_each(&file_priv->context_idr,
+				     context_idr_close_object, obj);
+			break;
+		}
+	}
+}
+
 static bool engine_has_idle_kernel_context(struct intel_engine_cs *engine)
 {
 	struct i915_gem_timeline *timeline;
@@ -750,6 +943,13 @@ int i915_gem_context_getparam_ioctl(struct drm_device *dev, void *data,
 	case I915_CONTEXT_PARAM_PRIORITY:
 		args->value = ctx->priority;
 		break;
+	case I915_CONTEXT_PARAM_FREEBSD_RESIDENT_SET:
+		ret = i915_mutex_lock_interruptible(dev);
+		if (ret)
+			break;
+		args->value = ctx->resident ? ctx->resident->count : 0;
+		mutex_unlock(&dev->struct_mutex);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -759,6 +959,185 @@ int i915_gem_context_getparam_ioctl(struct drm_device *dev, void *data,
 	return ret;
 }
 
+#define __RESIDENT_OBJECT_FLAGS (EXEC_OBJECT_WRITE | \
+				 EXEC_OBJECT_SUPPORTS_48B_ADDRESS | \
+				 EXEC_OBJECT_PINNED | \
+				 EXEC_OBJECT_ASYNC)
+
+static bool resident_set_misplaced(const struct i915_vma *vma, u64 flags)
+{
+	if (!drm_mm_node_allocated(&vma->node))
+		return false;
+
+	if (i915_vma_misplaced(vma, 0, 0, flags))
+		return true;
+
+	/* As eb_vma_misplaced(), i915_vma_misplaced() ignores PIN_ZONE_4G */
+	if (flags & PIN_ZONE_4G &&
+	    (vma->node.start + vma->node.size - 1) >> 32)
+		return true;
+
+	return false;
+}
+
+static int resident_set_pin(struct i915_vma *vma,
+			    struct drm_i915_gem_resident_object *entry)
+{
+	u64 flags = PIN_USER;
+	int err;
+
+	if (!(entry->flags & EXEC_OBJECT_SUPPORTS_48B_ADDRESS))
+		flags |= PIN_ZONE_4G;
+
+	if (entry->flags & EXEC_OBJECT_PINNED) {
+		/* As for execbuf, only accept page aligned canonical offsets */
+		if (entry->offset !=
+		    sign_extend64(entry->offset & PAGE_MASK, 47))
+			return -EINVAL;
+
+		flags |= PIN_OFFSET_FIXED |
+			 (entry->offset & GENMASK_ULL(47, 0));
+	}
+
+	/*
+	 * i915_vma_pin() accepts a vma wherever it is already bound, so move
+	 * it first if that does not satisfy the constraints of the set. This
+	 * fails with -EBUSY if the vma is still pinned elsewhere, e.g. by the
+	 * current set at another fixed offset.
+	 */
+	if (resident_set_misplaced(vma, flags)) {
+		err = i915_vma_unbind(vma);
+		if (err)
+			return err;
+	}
+
+	return i915_vma_pin(vma, 0, 0, flags);
+}
+
+/*
+ * Every object of a set stays pinned for the lifetime of the set, so bound
+ * its length rather than letting one client pin an unlimited number of vmas.
+ */
+#define I915_RESIDENT_SET_MAX 512
+
+static int set_resident_set(struct i915_gem_context *ctx,
+			    struct drm_file *file,
+			    struct drm_i915_gem_context_param *args)
+{
+	struct drm_i915_private *i915 = ctx->i915;
+	struct drm_i915_gem_resident_object __user *user =
+		u64_to_user_ptr(args->value);
+	struct drm_i915_gem_resident_object *objects = NULL;
+	struct i915_gem_resident_set *set = NULL;
+	struct i915_address_space *vm;
+	unsigned int count, n;
+	int err;
+
+	if (args->size % sizeof(*objects))
+		return -EINVAL;
+
+	/*
+	 * Copy the array in before taking struct_mutex, as faulting on the
+	 * user pointer may itself require struct_mutex.
+	 */
+	count = args->size / sizeof(*objects);
+	if (count > I915_RESIDENT_SET_MAX)
+		return -E2BIG;
+
+	/*
+	 * Without a ppgtt the set would be pinned into the shared GGTT, where
+	 * it takes aperture space away from every other client.
+	 */
+	if (count && !ctx->ppgtt && !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (count) {
+		objects = kvmalloc_array(count, sizeof(*objects), GFP_KERNEL);
+		if (!objects)
+			return -ENOMEM;
+
+		if (copy_from_user(objects, user, args->size)) {
+			err = -EFAULT;
+			goto out_objects;
+		}
+
+		set = kvmalloc(sizeof(*set) + count * sizeof(set->entries[0]),
+			       GFP_KERNEL);
+		if (!set) {
+			err = -ENOMEM;
+			goto out_objects;
+		}
+		set->count = 0;
+	}
+
+	err = i915_mutex_lock_interruptible(&i915->drm);
+	if (err)
+		goto out_set;
+
+	if (i915_gem_context_is_closed(ctx)) {
+		err = -ENOENT;
+		goto out_unlock;
+	}
+
+	vm = ctx->ppgtt ? &ctx->ppgtt->base : &i915->ggtt.base;
+	for (n = 0; n < count; n++) {
+		struct drm_i915_gem_resident_object *entry = &objects[n];
+		struct drm_i915_gem_object *obj;
+		struct i915_vma *vma;
+
+		if (entry->flags & ~__RESIDENT_OBJECT_FLAGS) {
+			err = -EINVAL;
+			goto out_unlock;
+		}
+
+		obj = i915_gem_object_lookup(file, entry->handle);
+		if (!obj) {
+			err = -ENOENT;
+			goto out_unlock;
+		}
+
+		vma = i915_vma_instance(obj, vm, NULL);
+		if (IS_ERR(vma))
+			err = PTR_ERR(vma);
+		else
+			err = resident_set_pin(vma, entry);
+		if (err) {
+			i915_gem_object_put(obj);
+			goto out_unlock;
+		}
+
+		entry->offset = sign_extend64(vma->node.start, 47);
+
+		set->entries[set->count].vma = vma;
+		set->entries[set->count].flags = entry->flags;
+		set->count++;
+	}
+
+	/*
+	 * Only release the old set once the new one is bound, so that a
+	 * failure leaves the context as it was.
+	 */
+	swap(ctx->resident, set);
+out_unlock:
+	resident_set_free(set);
+	set = NULL;
+	mutex_unlock(&i915->drm.struct_mutex);
+
+	if (!err) {
+		for (n = 0; n < count; n++) {
+			if (put_user(objects[n].offset, &user[n].offset)) {
+				err = -EFAULT;
+				break;
+			}
+		}
+	}
+out_set:
+	kvfree(set);
+out_objects:
+	kvfree(objects);
+	return err;
+}
+
 int i915_gem_context_setparam_ioctl(struct drm_device *dev, void *data,
 				    struct drm_file *file)
 {
@@ -771,6 +1150,11 @@ int i915_gem_context_setparam_ioctl(struct drm_device *dev, void *data,
 	if (!ctx)
 		return -ENOENT;
 
+	if (args->param == I915_CONTEXT_PARAM_FREEBSD_RESIDENT_SET) {
+		ret = set_resident_set(ctx, file, args);
+		goto out;
+	}
+
 	ret = i915_mutex_lock_interruptible(dev);
 	if (ret)
 		goto out;
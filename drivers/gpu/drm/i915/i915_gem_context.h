@@ -26,8 +26,9 @@
 #define __I915_GEM_CONTEXT_H__
 
 #include <linux/bitops.h>
+#include <linux/hash.h>
 #include <linux/list.h>
-#include <linux/radix-tree.h>
+#include <linux/prefetch.h>
 
 #ifdef __linux__ // FreeBSD use pid_t
 struct pid;
@@ -38,12 +39,44 @@ struct drm_file;
 
 struct drm_i915_private;
 struct drm_i915_file_private;
+struct drm_i915_gem_object;
 struct i915_hw_ppgtt;
 struct i915_vma;
 struct intel_ring;
 
 #define DEFAULT_CONTEXT_HANDLE 0
 
+/**
+ * struct i915_handle_table - open-addressed map from user handle to vma
+ *
+ * A flat array of slots probed linearly from hash_32(handle), grown to keep
+ * it at most half full. A slot with a NULL vma is empty. Execbuf resolves
+ * every handle of the request against it, so it is kept compact enough to
+ * be prefetched ahead of the lookups.
+ */
+struct i915_handle_table {
+	struct i915_handle_slot {
+		u32 handle;
+		struct i915_vma *vma;
+	} *slots;
+	unsigned int bits;
+	unsigned int count;
+};
+
+/**
+ * struct i915_gem_resident_set - objects kept bound across execbuf
+ *
+ * Installed with I915_CONTEXT_PARAM_FREEBSD_RESIDENT_SET. Each vma holds a
+ * pin and a reference on its object for as long as it remains in the set.
+ */
+struct i915_gem_resident_set {
+	unsigned int count;
+	struct {
+		struct i915_vma *vma;
+		unsigned int flags;
+	} entries[];
+};
+
 /**
  * struct i915_gem_context - client state
  *
@@ -192,17 +225,22 @@ struct i915_gem_context {
 	/** jump_whitelist_cmds: No of cmd slots available */
 	u32 jump_whitelist_cmds;
 
-	/** handles_vma: rbtree to look up our context specific obj/vma for
+	/** handles_vma: hashtable to look up our context specific obj/vma for
 	 * the user handle. (user handles are per fd, but the binding is
 	 * per vm, which may be one per context or shared with the global GTT)
 	 */
-	struct radix_tree_root handles_vma;
+	struct i915_handle_table handles_vma;
 
-	/** handles_list: reverse list of all the rbtree entries in use for
+	/** handles_list: reverse list of all the hashtable entries in use for
 	 * this context, which allows us to free all the allocations on
 	 * context close.
 	 */
 	struct list_head handles_list;
+
+	/** resident: objects bound and pinned in this context's address
+	 * space and included in every execbuf, or NULL.
+	 */
+	struct i915_gem_resident_set *resident;
 };
 
 static inline bool i915_gem_context_is_closed(const struct i915_gem_context *ctx)
@@ -277,6 +315,42 @@ static inline bool i915_gem_context_is_kernel(struct i915_gem_context *ctx)
 }
 
 /* i915_gem_context.c */
+static inline void i915_handle_table_init(struct i915_handle_table *t)
+{
+	t->slots = NULL;
+	t->bits = 0;
+	t->count = 0;
+}
+
+static inline struct i915_vma *
+i915_handle_table_lookup(const struct i915_handle_table *t, u32 handle)
+{
+	const unsigned int mask = BIT(t->bits) - 1;
+	unsigned int i;
+
+	if (unlikely(!t->slots))
+		return NULL;
+
+	for (i = hash_32(handle, t->bits); t->slots[i].vma; i = (i + 1) & mask) {
+		if (t->slots[i].handle == handle)
+			return t->slots[i].vma;
+	}
+
+	return NULL;
+}
+
+static inline void
+i915_handle_table_prefetch(const struct i915_handle_table *t, u32 handle)
+{
+	if (t->slots)
+		prefetch(&t->slots[hash_32(handle, t->bits)]);
+}
+
+int i915_handle_table_insert(struct i915_handle_table *t,
+			     u32 handle, struct i915_vma *vma);
+struct i915_vma *i915_handle_table_remove(struct i915_handle_table *t,
+					  u32 handle);
+
 int __must_check i915_gem_contexts_init(struct drm_i915_private *dev_priv);
 void i915_gem_contexts_lost(struct drm_i915_private *dev_priv);
 void i915_gem_contexts_fini(struct drm_i915_private *dev_priv);
@@ -284,6 +358,8 @@ void i915_gem_contexts_fini(struct drm_i915_private *dev_priv);
 int i915_gem_context_open(struct drm_i915_private *i915,
 			  struct drm_file *file);
 void i915_gem_context_close(struct drm_file *file);
+void i915_gem_context_close_object(struct drm_file *file,
+				   struct drm_i915_gem_object *obj);
 
 int i915_switch_context(struct drm_i915_gem_request *req);
 int i915_gem_switch_to_kernel_context(struct drm_i915_private *dev_priv);
@@ -28,6 +28,7 @@
 
 #include <linux/dma_remapping.h>
 #include <linux/reservation.h>
+#include <linux/sort.h>
 #include <linux/sync_file.h>
 #include <linux/uaccess.h>
 
@@ -119,6 +120,13 @@ enum {
  *      To avoid stalling, execobject.offset should match the current
  *      address of that object within the active context.
  *
+ * Clients that reuse the same working set across many batches can go one step
+ * further and install it on the context once with
+ * I915_CONTEXT_PARAM_FREEBSD_RESIDENT_SET. Those objects are pinned at fixed
+ * offsets for the lifetime of the set, and every execbuf on the context
+ * includes them without any per-call lookup, reservation or relocation; only
+ * the batch and any transient objects need to be listed in execobject[].
+ *
  * The reservation is done is multiple phases. First we try and keep any
  * object already bound in its current location - so as long as meets the
  * constraints imposed by the new execbuffer. Any object left unbound after the
@@ -233,6 +241,7 @@ struct i915_execbuffer {
 		bool needs_unfenced : 1;
 
 		struct drm_i915_gem_request *rq;
+		struct i915_vma *rq_vma; /** Last object added to rq */
 		u32 *rq_cmd;
 		unsigned int rq_size;
 	} reloc_cache;
@@ -690,9 +699,13 @@ static int eb_select_context(struct i915_execbuffer *eb)
 	return 0;
 }
 
+/* How many handles ahead of the lookup we prefetch their hash slots */
+#define EB_LOOKUP_PREFETCH 8
+
 static int eb_lookup_vmas(struct i915_execbuffer *eb)
 {
-	struct radix_tree_root *handles_vma = &eb->ctx->handles_vma;
+	struct i915_handle_table *handles_vma = &eb->ctx->handles_vma;
+	const unsigned int count = eb->buffer_count;
 	struct drm_i915_gem_object *obj;
 	unsigned int i;
 	int err;
@@ -706,15 +719,35 @@ static int eb_lookup_vmas(struct i915_execbuffer *eb)
 	INIT_LIST_HEAD(&eb->relocs);
 	INIT_LIST_HEAD(&eb->unbound);
 
-	for (i = 0; i < eb->buffer_count; i++) {
+	/*
+	 * Resolve all the handles we have seen before in a single sweep over
+	 * the table, prefetching the slots for the handles ahead of us. The
+	 * results are parked in eb->vma[] until eb_add_vma() claims them; on
+	 * error, eb->vma[i] is cleared so that eb_release_vmas() stops there.
+	 */
+	for (i = 0; i < count; i++) {
+		if (i + EB_LOOKUP_PREFETCH < count)
+			i915_handle_table_prefetch(handles_vma,
+						   eb->exec[i + EB_LOOKUP_PREFETCH].handle);
+
+		eb->vma[i] = i915_handle_table_lookup(handles_vma,
+						      eb->exec[i].handle);
+	}
+
+	for (i = 0; i < count; i++) {
 		u32 handle = eb->exec[i].handle;
 		struct i915_lut_handle *lut;
 		struct i915_vma *vma;
 
-		vma = radix_tree_lookup(handles_vma, handle);
+		vma = eb->vma[i];
 		if (likely(vma))
 			goto add_vma;
 
+		/* The same handle may have been added earlier in this pass */
+		vma = i915_handle_table_lookup(handles_vma, handle);
+		if (vma)
+			goto add_vma;
+
 		obj = i915_gem_object_lookup(eb->file, handle);
 		if (unlikely(!obj)) {
 			err = -ENOENT;
@@ -733,7 +766,7 @@ static int eb_lookup_vmas(struct i915_execbuffer *eb)
 			goto err_obj;
 		}
 
-		err = radix_tree_insert(handles_vma, handle, vma);
+		err = i915_handle_table_insert(handles_vma, handle, vma);
 		if (unlikely(err)) {
 			kmem_cache_free(eb->i915->luts, lut);
 			goto err_obj;
@@ -864,6 +897,7 @@ static void reloc_cache_init(struct reloc_cache *cache,
 	cache->needs_unfenced = INTEL_INFO(i915)->unfenced_needs_alignment;
 	cache->node.allocated = false;
 	cache->rq = NULL;
+	cache->rq_vma = NULL;
 	cache->rq_size = 0;
 }
 
@@ -895,14 +929,23 @@ static void reloc_gpu_flush(struct reloc_cache *cache)
 
 	__i915_add_request(cache->rq, true);
 	cache->rq = NULL;
+	cache->rq_vma = NULL;
 }
 
-static void reloc_cache_reset(struct reloc_cache *cache)
+/*
+ * The GPU relocation request is shared by all objects in the execbuf and is
+ * only submitted once we have finished relocating them all (or before we
+ * drop struct_mutex in the slow path).
+ */
+static void reloc_gpu_submit(struct reloc_cache *cache)
 {
-	void *vaddr;
-
 	if (cache->rq)
 		reloc_gpu_flush(cache);
+}
+
+static void reloc_cache_reset(struct reloc_cache *cache)
+{
+	void *vaddr;
 
 	if (!cache->vaddr)
 		return;
@@ -1071,6 +1114,24 @@ static void clflush_write32(u32 *addr, u32 value, unsigned int flushes)
 		*addr = value;
 }
 
+static int reloc_gpu_add_vma(struct reloc_cache *cache, struct i915_vma *vma)
+{
+	struct drm_i915_gem_request *rq = cache->rq;
+	int err;
+
+	err = i915_gem_request_await_object(rq, vma->obj, true);
+	if (err)
+		return err;
+
+	i915_vma_move_to_active(vma, rq, EXEC_OBJECT_WRITE);
+	reservation_object_lock(vma->resv, NULL);
+	reservation_object_add_excl_fence(vma->resv, &rq->fence);
+	reservation_object_unlock(vma->resv);
+
+	cache->rq_vma = vma;
+	return 0;
+}
+
 static int __reloc_gpu_alloc(struct i915_execbuffer *eb,
 			     struct i915_vma *vma,
 			     unsigned int len)
@@ -1116,7 +1177,8 @@ static int __reloc_gpu_alloc(struct i915_execbuffer *eb,
 		goto err_unpin;
 	}
 
-	err = i915_gem_request_await_object(rq, vma->obj, true);
+	cache->rq = rq;
+	err = reloc_gpu_add_vma(cache, vma);
 	if (err)
 		goto err_request;
 
@@ -1133,14 +1195,8 @@ static int __reloc_gpu_alloc(struct i915_execbuffer *eb,
 	reservation_object_unlock(batch->resv);
 	i915_vma_unpin(batch);
 
-	i915_vma_move_to_active(vma, rq, EXEC_OBJECT_WRITE);
-	reservation_object_lock(vma->resv, NULL);
-	reservation_object_add_excl_fence(vma->resv, &rq->fence);
-	reservation_object_unlock(vma->resv);
-
 	rq->batch = batch;
 
-	cache->rq = rq;
 	cache->rq_cmd = cmd;
 	cache->rq_size = 0;
 
@@ -1148,6 +1204,8 @@ static int __reloc_gpu_alloc(struct i915_execbuffer *eb,
 	return 0;
 
 err_request:
+	cache->rq = NULL;
+	cache->rq_vma = NULL;
 	i915_add_request(rq);
 err_unpin:
 	i915_vma_unpin(batch);
@@ -1166,6 +1224,23 @@ static u32 *reloc_gpu(struct i915_execbuffer *eb,
 	if (cache->rq_size > PAGE_SIZE/sizeof(u32) - (len + 1))
 		reloc_gpu_flush(cache);
 
+	if (cache->rq && cache->rq_vma != vma) {
+		/*
+		 * Inter-engine semaphore waits are emitted into the ring and
+		 * so must precede the batch; on such engines start a new
+		 * request for each object rather than join the current one.
+		 */
+		if (eb->engine->semaphore.sync_to) {
+			reloc_gpu_flush(cache);
+		} else {
+			int err;
+
+			err = reloc_gpu_add_vma(cache, vma);
+			if (unlikely(err))
+				return ERR_PTR(err);
+		}
+	}
+
 	if (unlikely(!cache->rq)) {
 		int err;
 
@@ -1372,13 +1447,54 @@ eb_relocate_entry(struct i915_execbuffer *eb,
 	return relocate_entry(vma, reloc, eb, target);
 }
 
+static int cmp_u64(const void *A, const void *B)
+{
+	const u64 *a = A, *b = B;
+
+	if (*a < *b)
+		return -1;
+	else if (*a > *b)
+		return 1;
+	else
+		return 0;
+}
+
+/*
+ * The CPU relocation path writes through a single cached kmap/iomap of the
+ * current page (see reloc_vaddr()), so relocations that hop between pages
+ * pay for a remap each time. Apply each batch of relocations in page order
+ * instead, keeping the user's order for entries within the same page (the
+ * index is the low half of the key, so the sort is stable). Userspace
+ * normally emits relocations in batch order, in which case no sort is needed.
+ */
+static void reloc_sort_by_page(const struct drm_i915_gem_relocation_entry *r,
+			       u64 *keys, unsigned int count)
+{
+	bool sorted = true;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		u64 page = min_t(u64, r[i].offset >> PAGE_SHIFT, U32_MAX);
+
+		keys[i] = page << 32 | i;
+		if (i && keys[i] < keys[i - 1])
+			sorted = false;
+	}
+
+	if (!sorted)
+		sort(keys, count, sizeof(*keys), cmp_u64, NULL);
+}
+
 static int eb_relocate_vma(struct i915_execbuffer *eb, struct i915_vma *vma)
 {
 #define N_RELOC(x) ((x) / sizeof(struct drm_i915_gem_relocation_entry))
 	struct drm_i915_gem_relocation_entry stack[N_RELOC(512)];
+	u64 stack_keys[ARRAY_SIZE(stack)];
+	struct drm_i915_gem_relocation_entry *relocs = stack;
 	struct drm_i915_gem_relocation_entry __user *urelocs;
 	const struct drm_i915_gem_exec_object2 *entry = exec_entry(eb, vma);
-	unsigned int remain;
+	unsigned int remain, max = ARRAY_SIZE(stack);
+	u64 *keys = stack_keys;
 
 	urelocs = u64_to_user_ptr(entry->relocs_ptr);
 	remain = entry->relocation_count;
@@ -1393,11 +1509,28 @@ static int eb_relocate_vma(struct i915_execbuffer *eb, struct i915_vma *vma)
 	if (unlikely(!access_ok(VERIFY_READ, urelocs, remain*sizeof(*urelocs))))
 		return -EFAULT;
 
+	/*
+	 * Large relocation lists are processed in bigger batches so that
+	 * sorting by page has a chance to group them. This is purely an
+	 * optimisation, so if the allocation fails just use the stack.
+	 */
+	if (remain > max) {
+		unsigned int n = min_t(unsigned int, remain, N_RELOC(32*1024));
+		void *mem;
+
+		mem = kmalloc_array(n, sizeof(*relocs) + sizeof(*keys),
+				    GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN);
+		if (mem) {
+			keys = mem;
+			relocs = mem + n * sizeof(*keys);
+			max = n;
+		}
+	}
+
 	do {
-		struct drm_i915_gem_relocation_entry *r = stack;
-		unsigned int count =
-			min_t(unsigned int, remain, ARRAY_SIZE(stack));
-		unsigned int copied;
+		struct drm_i915_gem_relocation_entry *r = relocs;
+		unsigned int count = min_t(unsigned int, remain, max);
+		unsigned int copied, i;
 
 		/*
 		 * This is the fast path and we cannot handle a pagefault
@@ -1415,9 +1548,12 @@ static int eb_relocate_vma(struct i915_execbuffer *eb, struct i915_vma *vma)
 			goto out;
 		}
 
+		reloc_sort_by_page(r, keys, count);
+
 		remain -= count;
-		do {
-			u64 offset = eb_relocate_entry(eb, vma, r);
+		for (i = 0; i < count; i++) {
+			unsigned int idx = lower_32_bits(keys[i]);
+			u64 offset = eb_relocate_entry(eb, vma, &r[idx]);
 
 			if (likely(offset == 0)) {
 			} else if ((s64)offset < 0) {
@@ -1447,13 +1583,15 @@ static int eb_relocate_vma(struct i915_execbuffer *eb, struct i915_vma *vma)
 				 */
 				offset = gen8_canonical_addr(offset & ~UPDATE);
 				__put_user(offset,
-					   &urelocs[r-stack].presumed_offset);
+					   &urelocs[idx].presumed_offset);
 			}
-		} while (r++, --count);
-		urelocs += ARRAY_SIZE(stack);
+		}
+		urelocs += count;
 	} while (remain);
 out:
 	reloc_cache_reset(&eb->reloc_cache);
+	if (keys != stack_keys)
+		kfree(keys);
 	return remain;
 }
 
@@ -1463,11 +1601,20 @@ eb_relocate_vma_slow(struct i915_execbuffer *eb, struct i915_vma *vma)
 	const struct drm_i915_gem_exec_object2 *entry = exec_entry(eb, vma);
 	struct drm_i915_gem_relocation_entry *relocs =
 		u64_to_ptr(typeof(*relocs), entry->relocs_ptr);
+	const unsigned int count = entry->relocation_count;
 	unsigned int i;
+	u64 *keys;
 	int err;
 
-	for (i = 0; i < entry->relocation_count; i++) {
-		u64 offset = eb_relocate_entry(eb, vma, &relocs[i]);
+	/* As in the fast path, apply the relocations in page order if we can */
+	keys = kvmalloc_array(count, sizeof(*keys),
+			      GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN);
+	if (keys)
+		reloc_sort_by_page(relocs, keys, count);
+
+	for (i = 0; i < count; i++) {
+		unsigned int idx = keys ? lower_32_bits(keys[i]) : i;
+		u64 offset = eb_relocate_entry(eb, vma, &relocs[idx]);
 
 		if ((s64)offset < 0) {
 			err = (int)offset;
@@ -1477,6 +1624,7 @@ eb_relocate_vma_slow(struct i915_execbuffer *eb, struct i915_vma *vma)
 	err = 0;
 err:
 	reloc_cache_reset(&eb->reloc_cache);
+	kvfree(keys);
 	return err;
 }
 
@@ -1623,6 +1771,8 @@ static noinline int eb_relocate_slow(struct i915_execbuffer *eb)
 	int err = 0;
 
 repeat:
+	reloc_gpu_submit(&eb->reloc_cache);
+
 	if (signal_pending(current)) {
 		err = -ERESTARTSYS;
 		goto out;
@@ -1697,6 +1847,7 @@ repeat:
 	 */
 
 err:
+	reloc_gpu_submit(&eb->reloc_cache);
 	if (err == -EAGAIN)
 		goto repeat;
 
@@ -1729,11 +1880,17 @@ static int eb_relocate(struct i915_execbuffer *eb)
 	/* The objects are in their final locations, apply the relocations. */
 	if (eb->args->flags & __EXEC_HAS_RELOC) {
 		struct i915_vma *vma;
+		int err = 0;
 
 		list_for_each_entry(vma, &eb->relocs, reloc_link) {
-			if (eb_relocate_vma(eb, vma))
-				goto slow;
+			err = eb_relocate_vma(eb, vma);
+			if (err)
+				break;
 		}
+
+		reloc_gpu_submit(&eb->reloc_cache);
+		if (err)
+			goto slow;
 	}
 
 	return 0;
@@ -1761,12 +1918,60 @@ static void eb_export_fence(struct i915_vma *vma,
 	reservation_object_unlock(resv);
 }
 
+static int eb_move_resident_to_gpu(struct i915_execbuffer *eb)
+{
+	const struct i915_gem_resident_set *set = eb->ctx->resident;
+	unsigned int i;
+	int err;
+
+	if (!set)
+		return 0;
+
+	/*
+	 * The resident set is already bound and pinned at its final offsets
+	 * (see I915_CONTEXT_PARAM_FREEBSD_RESIDENT_SET), so there is nothing
+	 * to look up, reserve or relocate; we only need to serialise against
+	 * other users and track the request.
+	 */
+	for (i = 0; i < set->count; i++) {
+		unsigned int flags = set->entries[i].flags;
+		struct drm_i915_gem_object *obj = set->entries[i].vma->obj;
+
+		if (unlikely(obj->cache_dirty & ~obj->cache_coherent)) {
+			if (i915_gem_clflush_object(obj, 0))
+				flags &= ~EXEC_OBJECT_ASYNC;
+		}
+
+		if (flags & EXEC_OBJECT_ASYNC)
+			continue;
+
+		err = i915_gem_request_await_object
+			(eb->request, obj, flags & EXEC_OBJECT_WRITE);
+		if (err)
+			return err;
+	}
+
+	for (i = 0; i < set->count; i++) {
+		unsigned int flags = set->entries[i].flags;
+		struct i915_vma *vma = set->entries[i].vma;
+
+		i915_vma_move_to_active(vma, eb->request, flags);
+		eb_export_fence(vma, eb->request, flags);
+	}
+
+	return 0;
+}
+
 static int eb_move_to_gpu(struct i915_execbuffer *eb)
 {
 	const unsigned int count = eb->buffer_count;
 	unsigned int i;
 	int err;
 
+	err = eb_move_resident_to_gpu(eb);
+	if (err)
+		return err;
+
 	for (i = 0; i < count; i++) {
 		unsigned int flags = eb->flags[i];
 		struct i915_vma *vma = eb->vma[i];
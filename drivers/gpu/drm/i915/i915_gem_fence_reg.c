@@ -207,6 +207,41 @@ static void fence_write(struct drm_i915_fence_reg *fence,
 	fence->dirty = false;
 }
 
+/* How many past steals of an object we take into account */
+#define FENCE_STEAL_HISTORY 4
+
+/*
+ * The number of recent steals of @obj. Steals are forgotten once every fence
+ * could have changed hands FENCE_STEAL_HISTORY times since the object last
+ * lost its own, so that an object which stopped contending for fences is not
+ * protected forever by an old burst of faults.
+ */
+static unsigned int fence_steal_history(const struct drm_i915_private *i915,
+					const struct drm_i915_gem_object *obj)
+{
+	if (i915->mm.fence_stats.steals - obj->fence_stolen_at >
+	    FENCE_STEAL_HISTORY * i915->num_fence_regs)
+		return 0;
+
+	return min_t(unsigned int, obj->fence_steals, FENCE_STEAL_HISTORY);
+}
+
+/*
+ * Remember that the current owner lost its fence, both for the debugfs
+ * statistics and as the history used by fence_cost().
+ */
+static void fence_steal(struct drm_i915_fence_reg *fence)
+{
+	struct drm_i915_gem_object *obj = fence->vma->obj;
+	struct i915_fence_stats *stats = &fence->i915->mm.fence_stats;
+
+	if (i915_vma_has_userfault(fence->vma))
+		stats->revokes++;
+
+	obj->fence_steals = fence_steal_history(fence->i915, obj) + 1;
+	obj->fence_stolen_at = ++stats->steals;
+}
+
 static int fence_update(struct drm_i915_fence_reg *fence,
 			struct i915_vma *vma)
 {
@@ -237,6 +272,9 @@ static int fence_update(struct drm_i915_fence_reg *fence,
 	}
 
 	if (fence->vma && fence->vma != vma) {
+		if (vma)
+			fence_steal(fence);
+
 		/* Ensure that all userspace CPU access is completed before
 		 * stealing the fence.
 		 */
@@ -294,18 +332,50 @@ int i915_vma_put_fence(struct i915_vma *vma)
 	return fence_update(fence, NULL);
 }
 
+/*
+ * The cost of stealing a fence, cheapest first: a fence that is not in use,
+ * then one whose vma is not mmapped through the GTT (so no userspace fault
+ * follows the steal), then one backing a GTT mmap. The last are ranked by
+ * how often their object has recently lost its fence, on the prediction that
+ * an object which keeps faulting its fence back in will do so again.
+ */
+static unsigned int fence_cost(const struct drm_i915_fence_reg *fence)
+{
+	const struct i915_vma *vma = fence->vma;
+
+	if (!vma)
+		return 0;
+
+	if (!i915_vma_has_userfault(vma))
+		return 1;
+
+	return 2 + fence_steal_history(fence->i915, vma->obj);
+}
+
 static struct drm_i915_fence_reg *fence_find(struct drm_i915_private *dev_priv)
 {
-	struct drm_i915_fence_reg *fence;
+	struct drm_i915_fence_reg *fence, *victim = NULL;
+	unsigned int best = UINT_MAX;
 
+	/* The list is in LRU order, so ties go to the least recently used */
 	list_for_each_entry(fence, &dev_priv->mm.fence_list, link) {
+		unsigned int cost;
+
 		GEM_BUG_ON(fence->vma && fence->vma->fence != fence);
 
 		if (fence->pin_count)
 			continue;
 
-		return fence;
+		cost = fence_cost(fence);
+		if (cost < best) {
+			victim = fence;
+			best = cost;
+			if (!cost)
+				break;
+		}
 	}
+	if (victim)
+		return victim;
 
 	/* Wait for completion of pending flips which consume fences */
 	if (intel_has_pending_fb_unpin(dev_priv))
@@ -348,6 +418,7 @@ i915_vma_pin_fence(struct i915_vma *vma)
 	if (vma->fence) {
 		fence = vma->fence;
 		GEM_BUG_ON(fence->vma != vma);
+		fence->i915->mm.fence_stats.hits++;
 		fence->pin_count++;
 		if (!fence->dirty) {
 			list_move_tail(&fence->link,
@@ -355,6 +426,8 @@ i915_vma_pin_fence(struct i915_vma *vma)
 			return 0;
 		}
 	} else if (set) {
+		vma->vm->i915->mm.fence_stats.misses++;
+
 		fence = fence_find(vma->vm->i915);
 		if (IS_ERR(fence))
 			return PTR_ERR(fence);
@@ -804,3 +877,7 @@ i915_gem_object_save_bit_17_swizzle(struct drm_i915_gem_object *obj,
 		i++;
 	}
 }
+
+#if IS_ENABLED(CONFIG_DRM_I915_SELFTEST)
+#include "selftests/i915_gem_fence_reg.c"
+#endif
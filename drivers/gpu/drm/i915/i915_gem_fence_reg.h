@@ -49,5 +49,22 @@ struct drm_i915_fence_reg {
 	bool dirty;
 };
 
+/**
+ * struct i915_fence_stats - fence register allocation statistics
+ *
+ * Reported through debugfs (i915_gem_fence_regs) to show how hard the
+ * fence registers are being thrashed.
+ */
+struct i915_fence_stats {
+	/** @hits: pins of a vma that already owned its fence */
+	unsigned long hits;
+	/** @misses: pins that had to look for a fence */
+	unsigned long misses;
+	/** @steals: misses that took the fence from another vma */
+	unsigned long steals;
+	/** @revokes: steals that revoked a userspace GTT mmap */
+	unsigned long revokes;
+};
+
 #endif
 
@@ -382,37 +382,53 @@ static gen6_pte_t iris_pte_encode(dma_addr_t addr,
 	return pte;
 }
 
-static struct page *vm_alloc_page(struct i915_address_space *vm, gfp_t gfp)
+static void stash_init(struct pagestash *stash)
 {
-	struct pagevec *pvec = &vm->free_pages;
-	struct pagevec stash;
+	pagevec_init(&stash->pvec);
+	spin_lock_init(&stash->lock);
+}
 
-	if (I915_SELFTEST_ONLY(should_fail(&vm->fault_attr, 1)))
-		i915_gem_shrink_all(vm->i915);
+static struct page *stash_pop_page(struct pagestash *stash)
+{
+	struct page *page = NULL;
 
-	if (likely(pvec->nr))
-		return pvec->pages[--pvec->nr];
+	spin_lock(&stash->lock);
+	if (likely(stash->pvec.nr))
+		page = stash->pvec.pages[--stash->pvec.nr];
+	spin_unlock(&stash->lock);
 
-	if (!vm->pt_kmap_wc)
-		return alloc_page(gfp);
+	return page;
+}
 
-	/* A placeholder for a specific mutex to guard the WC stash */
-	lockdep_assert_held(&vm->i915->drm.struct_mutex);
+static void stash_push_pagevec(struct pagestash *stash, struct pagevec *pvec)
+{
+	int nr;
 
-	/* Look in our global stash of WC pages... */
-	pvec = &vm->i915->mm.wc_stash;
-	if (likely(pvec->nr))
-		return pvec->pages[--pvec->nr];
+	spin_lock_nested(&stash->lock, SINGLE_DEPTH_NESTING);
+
+	nr = min_t(int, pvec->nr, pagevec_space(&stash->pvec));
+	memcpy(stash->pvec.pages + stash->pvec.nr,
+	       pvec->pages + pvec->nr - nr,
+	       sizeof(pvec->pages[0]) * nr);
+	stash->pvec.nr += nr;
+
+	spin_unlock(&stash->lock);
+
+	pvec->nr -= nr;
+}
 
+static void stash_fill_wc(struct pagestash *stash, struct pagevec *stack,
+			  gfp_t gfp)
+{
 	/*
-	 * Otherwise batch allocate pages to amoritize cost of set_pages_wc.
+	 * Batch allocate pages to amortize the cost of set_pages_wc.
 	 *
 	 * We have to be careful as page allocation may trigger the shrinker
 	 * (via direct reclaim) which will fill up the WC stash underneath us.
 	 * So we add our WB pages into a temporary pvec on the stack and merge
 	 * them into the WC stash after all the allocations are complete.
 	 */
-	pagevec_init(&stash);
+	pagevec_init(stack);
 	do {
 		struct page *page;
 
@@ -420,59 +436,131 @@ static struct page *vm_alloc_page(struct i915_address_space *vm, gfp_t gfp)
 		if (unlikely(!page))
 			break;
 
-		stash.pages[stash.nr++] = page;
-	} while (stash.nr < pagevec_space(pvec));
+		stack->pages[stack->nr++] = page;
+	} while (pagevec_space(stack));
 
-	if (stash.nr) {
-		int nr = min_t(int, stash.nr, pagevec_space(pvec));
-		struct page **pages = stash.pages + stash.nr - nr;
+	if (stack->nr && set_pages_array_wc(stack->pages, stack->nr)) {
+		/* Failed to change the caching, give the pages back */
+		__pagevec_release(stack);
+		return;
+	}
 
-		if (nr && !set_pages_array_wc(pages, nr)) {
-			memcpy(pvec->pages + pvec->nr,
-			       pages, sizeof(pages[0]) * nr);
-			pvec->nr += nr;
-			stash.nr -= nr;
-		}
+	if (stash)
+		stash_push_pagevec(stash, stack);
+}
+
+static void wc_stash_worker(struct work_struct *work)
+{
+	struct drm_i915_private *i915 =
+		container_of(work, typeof(*i915), mm.wc_stash_work);
+	struct pagevec stack;
+
+	/*
+	 * Refill the global stash in the background, so that the expensive
+	 * change of caching (requiring a stop_machine() on x86) is rarely
+	 * incurred by the client creating a new address space.
+	 */
+	if (READ_ONCE(i915->mm.wc_stash.pvec.nr) >= PAGEVEC_SIZE / 2)
+		return;
+
+	stash_fill_wc(&i915->mm.wc_stash, &stack,
+		      I915_GFP_DMA | __GFP_NORETRY | __GFP_NOWARN);
 
-		pagevec_release(&stash);
+	/* The stash was refilled by someone else while we slept */
+	if (unlikely(stack.nr)) {
+		WARN_ON_ONCE(set_pages_array_wb(stack.pages, stack.nr));
+		__pagevec_release(&stack);
 	}
+}
+
+static struct page *vm_alloc_page(struct i915_address_space *vm, gfp_t gfp)
+{
+	struct pagestash *stash;
+	struct pagevec stack;
+	struct page *page;
 
-	return likely(pvec->nr) ? pvec->pages[--pvec->nr] : NULL;
+	if (I915_SELFTEST_ONLY(should_fail(&vm->fault_attr, 1)))
+		i915_gem_shrink_all(vm->i915);
+
+	page = stash_pop_page(&vm->free_pages);
+	if (page)
+		return page;
+
+	if (!vm->pt_kmap_wc)
+		return alloc_page(gfp);
+
+	/* Look in our global stash of WC pages... */
+	stash = &vm->i915->mm.wc_stash;
+	page = stash_pop_page(stash);
+	if (page) {
+		/* ...and start topping it up before it runs dry */
+		if (READ_ONCE(stash->pvec.nr) < PAGEVEC_SIZE / 2)
+			queue_work(system_unbound_wq,
+				   &vm->i915->mm.wc_stash_work);
+		return page;
+	}
+
+	/* Otherwise we have no choice but to refill the stash ourselves */
+	stash_fill_wc(NULL, &stack, gfp);
+	if (!stack.nr)
+		return NULL;
+
+	page = stack.pages[--stack.nr];
+
+	/* Merge spare WC pages to the global stash */
+	stash_push_pagevec(stash, &stack);
+
+	/* Push any surplus WC pages onto the local VM stash */
+	if (stack.nr)
+		stash_push_pagevec(&vm->free_pages, &stack);
+
+	/* Return unwanted leftovers */
+	if (unlikely(stack.nr)) {
+		WARN_ON_ONCE(set_pages_array_wb(stack.pages, stack.nr));
+		__pagevec_release(&stack);
+	}
+
+	return page;
 }
 
 static void vm_free_pages_release(struct i915_address_space *vm,
 				  bool immediate)
 {
-	struct pagevec *pvec = &vm->free_pages;
+	struct pagevec *pvec = &vm->free_pages.pvec;
+	struct pagevec stack;
 
+	lockdep_assert_held(&vm->free_pages.lock);
 	GEM_BUG_ON(!pagevec_count(pvec));
 
 	if (vm->pt_kmap_wc) {
-		struct pagevec *stash = &vm->i915->mm.wc_stash;
-
-		/* When we use WC, first fill up the global stash and then
+		/*
+		 * When we use WC, first fill up the global stash and then
 		 * only if full immediately free the overflow.
 		 */
+		stash_push_pagevec(&vm->i915->mm.wc_stash, pvec);
 
-		lockdep_assert_held(&vm->i915->drm.struct_mutex);
-		if (pagevec_space(stash)) {
-			do {
-				stash->pages[stash->nr++] =
-					pvec->pages[--pvec->nr];
-				if (!pvec->nr)
-					return;
-			} while (pagevec_space(stash));
-
-			/* As we have made some room in the VM's free_pages,
-			 * we can wait for it to fill again. Unless we are
-			 * inside i915_address_space_fini() and must
-			 * immediately release the pages!
-			 */
-			if (!immediate)
-				return;
-		}
+		/*
+		 * As we have made some room in the VM's free_pages,
+		 * we can wait for it to fill again. Unless we are
+		 * inside i915_address_space_fini() and must
+		 * immediately release the pages!
+		 */
+		if (pvec->nr <= (immediate ? 0 : PAGEVEC_SIZE - 1))
+			return;
 
+		/*
+		 * We have to drop the lock to allow ourselves to sleep,
+		 * so take a copy of the pvec and clear the stash for
+		 * others to use it as we sleep.
+		 */
+		stack = *pvec;
+		pagevec_reinit(pvec);
+		spin_unlock(&vm->free_pages.lock);
+
+		pvec = &stack;
 		set_pages_array_wb(pvec->pages, pvec->nr);
+
+		spin_lock(&vm->free_pages.lock);
 	}
 
 	__pagevec_release(pvec);
@@ -488,8 +576,10 @@ static void vm_free_page(struct i915_address_space *vm, struct page *page)
 	 * unconditional might_sleep() for everybody.
 	 */
 	might_sleep();
-	if (!pagevec_add(&vm->free_pages, page))
+	spin_lock(&vm->free_pages.lock);
+	if (!pagevec_add(&vm->free_pages.pvec, page))
 		vm_free_pages_release(vm, false);
+	spin_unlock(&vm->free_pages.lock);
 }
 
 static int __setup_page_dma(struct i915_address_space *vm,
@@ -620,10 +710,40 @@ static void cleanup_scratch_page(struct i915_address_space *vm)
 	__free_pages(p->page, p->order);
 }
 
+/*
+ * Bound how many empty page tables (and directories) each address space may
+ * keep around for reuse, 1MiB worth of pages.
+ */
+#define I915_PT_CACHE_MAX 256
+
+static void pt_cache_add(struct i915_address_space *vm,
+			 struct list_head *link, struct list_head *list)
+{
+	list_add_tail(link, list);
+	vm->pt_cache.count++;
+	vm->i915->mm.pt_cache_count++;
+}
+
+static void pt_cache_del(struct i915_address_space *vm, struct list_head *link)
+{
+	list_del(link);
+	GEM_BUG_ON(!vm->pt_cache.count);
+	vm->pt_cache.count--;
+	vm->i915->mm.pt_cache_count--;
+}
+
 static struct i915_page_table *alloc_pt(struct i915_address_space *vm)
 {
 	struct i915_page_table *pt;
 
+	/* Reuse the most recently emptied, and so likely cache hot, table */
+	if (!list_empty(&vm->pt_cache.pt)) {
+		pt = list_last_entry(&vm->pt_cache.pt, typeof(*pt), cache_link);
+		pt_cache_del(vm, &pt->cache_link);
+		GEM_BUG_ON(pt->used_ptes);
+		return pt;
+	}
+
 	pt = kmalloc(sizeof(*pt), GFP_KERNEL | __GFP_NOWARN);
 	if (unlikely(!pt))
 		return ERR_PTR(-ENOMEM);
@@ -643,6 +763,21 @@ static void free_pt(struct i915_address_space *vm, struct i915_page_table *pt)
 	kfree(pt);
 }
 
+static void cache_pt(struct i915_address_space *vm, struct i915_page_table *pt)
+{
+	/*
+	 * The stale PTEs are left in place, as they are no longer reachable
+	 * by the GPU; like a freshly allocated page, the table is reset to
+	 * scratch by gen8_ppgtt_alloc_pd() unless it is about to be filled.
+	 */
+	if (vm->pt_cache.count >= I915_PT_CACHE_MAX) {
+		free_pt(vm, pt);
+		return;
+	}
+
+	pt_cache_add(vm, &pt->cache_link, &vm->pt_cache.pt);
+}
+
 static void gen8_initialize_pt(struct i915_address_space *vm,
 			       struct i915_page_table *pt)
 {
@@ -661,6 +796,13 @@ static struct i915_page_directory *alloc_pd(struct i915_address_space *vm)
 {
 	struct i915_page_directory *pd;
 
+	if (!list_empty(&vm->pt_cache.pd)) {
+		pd = list_last_entry(&vm->pt_cache.pd, typeof(*pd), cache_link);
+		pt_cache_del(vm, &pd->cache_link);
+		GEM_BUG_ON(pd->used_pdes);
+		return pd;
+	}
+
 	pd = kzalloc(sizeof(*pd), GFP_KERNEL | __GFP_NOWARN);
 	if (unlikely(!pd))
 		return ERR_PTR(-ENOMEM);
@@ -681,6 +823,71 @@ static void free_pd(struct i915_address_space *vm,
 	kfree(pd);
 }
 
+static void cache_pd(struct i915_address_space *vm,
+		     struct i915_page_directory *pd)
+{
+	if (vm->pt_cache.count >= I915_PT_CACHE_MAX) {
+		free_pd(vm, pd);
+		return;
+	}
+
+	pt_cache_add(vm, &pd->cache_link, &vm->pt_cache.pd);
+}
+
+static unsigned long pt_cache_shrink(struct i915_address_space *vm,
+				     unsigned long target)
+{
+	unsigned long freed = 0;
+
+	/* Release the oldest first, page tables before directories */
+	while (freed < target && !list_empty(&vm->pt_cache.pt)) {
+		struct i915_page_table *pt =
+			list_first_entry(&vm->pt_cache.pt,
+					 typeof(*pt), cache_link);
+
+		pt_cache_del(vm, &pt->cache_link);
+		free_pt(vm, pt);
+		freed++;
+	}
+
+	while (freed < target && !list_empty(&vm->pt_cache.pd)) {
+		struct i915_page_directory *pd =
+			list_first_entry(&vm->pt_cache.pd,
+					 typeof(*pd), cache_link);
+
+		pt_cache_del(vm, &pd->cache_link);
+		free_pd(vm, pd);
+		freed++;
+	}
+
+	return freed;
+}
+
+/**
+ * i915_ppgtt_shrink_cache - release unused page tables under memory pressure
+ * @i915: i915 device
+ * @target: the number of pages to release
+ *
+ * Returns the number of pages released.
+ */
+unsigned long i915_ppgtt_shrink_cache(struct drm_i915_private *i915,
+				      unsigned long target)
+{
+	struct i915_address_space *vm;
+	unsigned long freed = 0;
+
+	lockdep_assert_held(&i915->drm.struct_mutex);
+
+	list_for_each_entry(vm, &i915->vm_list, global_link) {
+		if (freed >= target || !i915->mm.pt_cache_count)
+			break;
+
+		freed += pt_cache_shrink(vm, target - freed);
+	}
+
+	return freed;
+}
+
 static void gen8_initialize_pd(struct i915_address_space *vm,
 			       struct i915_page_directory *pd)
 {
@@ -899,7 +1106,7 @@ static bool gen8_ppgtt_clear_pd(struct i915_address_space *vm,
 		GEM_BUG_ON(!pd->used_pdes);
 		pd->used_pdes--;
 
-		free_pt(vm, pt);
+		cache_pt(vm, pt);
 	}
 
 	return !pd->used_pdes;
@@ -941,7 +1148,7 @@ static bool gen8_ppgtt_clear_pdp(struct i915_address_space *vm,
 		GEM_BUG_ON(!pdp->used_pdpes);
 		pdp->used_pdpes--;
 
-		free_pd(vm, pd);
+		cache_pd(vm, pd);
 	}
 
 	return !pdp->used_pdpes;
@@ -1035,9 +1242,26 @@ gen8_ppgtt_insert_pte_entries(struct i915_hw_ppgtt *ppgtt,
 	pd = pdp->page_directory[idx->pdpe];
 	vaddr = kmap_atomic_px(pd->page_table[idx->pde]);
 	do {
-		vaddr[idx->pte] = pte_encode | iter->dma;
+		gen8_pte_t *pte = vaddr + idx->pte;
+		dma_addr_t dma = iter->dma;
+		unsigned int count;
+
+		/*
+		 * Fill as many PTEs as we can from this sg chunk with a
+		 * simple loop the compiler can unroll and vectorise, and only
+		 * then check for crossing into the next chunk or page table.
+		 * A tail shorter than a page still needs its own PTE.
+		 */
+		count = min_t(u64, GEN8_PTES - idx->pte,
+			      DIV_ROUND_UP(iter->max - dma, PAGE_SIZE));
+		GEM_BUG_ON(!count);
+		idx->pte += count - 1;
+		iter->dma += (dma_addr_t)count << PAGE_SHIFT;
+		do {
+			*pte++ = pte_encode | dma;
+			dma += PAGE_SIZE;
+		} while (--count);
 
-		iter->dma += PAGE_SIZE;
 		if (iter->dma >= iter->max) {
 			iter->sg = __sg_next(iter->sg);
 			if (!iter->sg) {
@@ -1138,12 +1362,27 @@ static void gen8_ppgtt_insert_huge_entries(struct i915_vma *vma,
 		}
 
 		do {
+			dma_addr_t dma = iter->dma;
+			unsigned int count;
+
 			GEM_BUG_ON(iter->sg->length < page_size);
-			vaddr[index++] = encode | iter->dma;
 
-			start += page_size;
-			iter->dma += page_size;
-			rem -= page_size;
+			/*
+			 * Write out the whole run within this sg chunk at once.
+			 * A tail shorter than page_size is left for the next
+			 * pass with a smaller page size; rounding it up would
+			 * map memory beyond the chunk.
+			 */
+			count = min_t(u64, max - index, div_u64(rem, page_size));
+			GEM_BUG_ON(!count);
+			start += (u64)count * page_size;
+			iter->dma += (dma_addr_t)count * page_size;
+			rem -= (dma_addr_t)count * page_size;
+			do {
+				vaddr[index++] = encode | dma;
+				dma += page_size;
+			} while (--count);
+
 			if (iter->dma >= iter->max) {
 				iter->sg = __sg_next(iter->sg);
 				if (!iter->sg)
@@ -1356,6 +1595,9 @@ static void gen8_ppgtt_cleanup(struct i915_address_space *vm)
 	else
 		gen8_ppgtt_cleanup_3lvl(&ppgtt->base, &ppgtt->pdp);
 
+	pt_cache_shrink(vm, ULONG_MAX);
+	GEM_BUG_ON(vm->pt_cache.count);
+
 	gen8_free_scratch(vm);
 }
 
@@ -2151,13 +2393,20 @@ static void i915_address_space_init(struct i915_address_space *vm,
 	INIT_LIST_HEAD(&vm->unbound_list);
 
 	list_add_tail(&vm->global_link, &dev_priv->vm_list);
-	pagevec_init(&vm->free_pages);
+	stash_init(&vm->free_pages);
+
+	INIT_LIST_HEAD(&vm->pt_cache.pt);
+	INIT_LIST_HEAD(&vm->pt_cache.pd);
+	vm->pt_cache.count = 0;
 }
 
 static void i915_address_space_fini(struct i915_address_space *vm)
 {
-	if (pagevec_count(&vm->free_pages))
+	spin_lock(&vm->free_pages.lock);
+	if (pagevec_count(&vm->free_pages.pvec))
 		vm_free_pages_release(vm, true);
+	GEM_BUG_ON(pagevec_count(&vm->free_pages.pvec));
+	spin_unlock(&vm->free_pages.lock);
 
 	i915_gem_timeline_fini(&vm->timeline);
 	drm_mm_takedown(&vm->mm);
@@ -2968,7 +3217,8 @@ void i915_ggtt_cleanup_hw(struct drm_i915_private *dev_priv)
 
 	ggtt->base.cleanup(&ggtt->base);
 
-	pvec = &dev_priv->mm.wc_stash;
+	cancel_work_sync(&dev_priv->mm.wc_stash_work);
+	pvec = &dev_priv->mm.wc_stash.pvec;
 	if (pvec->nr) {
 		set_pages_array_wb(pvec->pages, pvec->nr);
 		__pagevec_release(pvec);
@@ -3578,6 +3828,9 @@ int i915_ggtt_init_hw(struct drm_i915_private *dev_priv)
 
 	INIT_LIST_HEAD(&dev_priv->vm_list);
 
+	stash_init(&dev_priv->mm.wc_stash);
+	INIT_WORK(&dev_priv->mm.wc_stash_work, wc_stash_worker);
+
 	/* Note that we use page colouring to enforce a guard page at the
 	 * end of the address space. This is required as the CS may prefetch
 	 * beyond the end of the batch buffer, across the page boundary,
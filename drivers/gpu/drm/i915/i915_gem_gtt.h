@@ -238,6 +238,7 @@ struct i915_page_dma {
 struct i915_page_table {
 	struct i915_page_dma base;
 	unsigned int used_ptes;
+	struct list_head cache_link; /* vm->pt_cache.pt, while unused */
 };
 
 struct i915_page_directory {
@@ -245,6 +246,7 @@ struct i915_page_directory {
 
 	struct i915_page_table *page_table[I915_PDES]; /* PDEs */
 	unsigned int used_pdes;
+	struct list_head cache_link; /* vm->pt_cache.pd, while unused */
 };
 
 struct i915_page_directory_pointer {
@@ -258,6 +260,15 @@ struct i915_pml4 {
 	struct i915_page_directory_pointer *pdps[GEN8_PML4ES_PER_PML4];
 };
 
+/*
+ * A small stash of pages for page tables, with its own lock so that page
+ * table allocation does not depend upon struct_mutex.
+ */
+struct pagestash {
+	spinlock_t lock;
+	struct pagevec pvec;
+};
+
 struct i915_address_space {
 	struct drm_mm mm;
 	struct i915_gem_timeline timeline;
@@ -278,6 +289,15 @@ struct i915_address_space {
 
 	bool closed;
 
+	/**
+	 * Calls to i915_vma_pin() satisfied inline, as the vma was already
+	 * bound as requested, versus those that needed __i915_vma_do_pin().
+	 */
+	struct {
+		unsigned long fast;
+		unsigned long slow;
+	} pin_stats;
+
 	struct i915_page_dma scratch_page;
 	struct i915_page_table *scratch_pt;
 	struct i915_page_directory *scratch_pd;
@@ -313,7 +333,18 @@ struct i915_address_space {
 	 */
 	struct list_head unbound_list;
 
-	struct pagevec free_pages;
+	struct pagestash free_pages;
+
+	/**
+	 * Page tables and directories that have become empty are kept here,
+	 * least recently used first, for reuse by the next bind into any
+	 * range, and only released under memory pressure by the shrinker.
+	 */
+	struct {
+		struct list_head pt;
+		struct list_head pd;
+		unsigned int count;
+	} pt_cache;
 
 	/* Some systems require uncached updates of the page directories */
 	bool pt_kmap_wc:1;
@@ -607,6 +638,8 @@ struct i915_hw_ppgtt *i915_ppgtt_create(struct drm_i915_private *dev_priv,
 					struct drm_i915_file_private *fpriv,
 					const char *name);
 void i915_ppgtt_close(struct i915_address_space *vm);
+unsigned long i915_ppgtt_shrink_cache(struct drm_i915_private *i915,
+				      unsigned long target);
 static inline void i915_ppgtt_get(struct i915_hw_ppgtt *ppgtt)
 {
 	if (ppgtt)
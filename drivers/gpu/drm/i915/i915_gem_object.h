@@ -126,6 +126,14 @@ struct drm_i915_gem_object {
 	unsigned int userfault_count;
 	struct list_head userfault_link;
 
+	/**
+	 * The GGTT view last faulted into userspace, so that another fault
+	 * upon the same view can be serviced without struct_mutex. Cleared
+	 * under @userfault_lock whenever the mmap is revoked.
+	 */
+	struct mutex userfault_lock;
+	struct i915_vma *userfault_vma;
+
 	struct list_head batch_pool_link;
 	I915_SELFTEST_DECLARE(struct list_head st_link);
 
@@ -157,6 +165,11 @@ struct drm_i915_gem_object {
 #define TILING_MASK (FENCE_MINIMUM_STRIDE-1)
 #define STRIDE_MASK (~TILING_MASK)
 
+	/** Recent steals of our fence register by another vma (aged) */
+	unsigned int fence_steals;
+	/** mm.fence_stats.steals as of our last steal, to age fence_steals */
+	unsigned long fence_stolen_at;
+
 	/** Count of VMA actually bound by this object */
 	unsigned int bind_count;
 	unsigned int active_count;
@@ -77,6 +77,100 @@ static signed long i915_fence_wait(struct dma_fence *fence,
 	return i915_wait_request(to_request(fence), interruptible, timeout);
 }
 
+/*
+ * Keep a few released requests on each engine to be reused by the next
+ * allocation, bypassing the slab. As the slab cache is SLAB_TYPESAFE_BY_RCU,
+ * a released request may already be immediately reused and so RCU lookups
+ * (see __i915_gem_active_get_rcu()) must already cope with a request being
+ * recycled underneath them; reusing it from our own freelist offers no new
+ * hazards so long as the memory is only ever reused as another request.
+ */
+#define I915_REQUEST_POOL_SIZE 32
+
+static void request_pool_put(struct drm_i915_gem_request *req)
+{
+	struct intel_engine_cs *engine = req->engine;
+
+	/*
+	 * The fence may be released long after the request was retired, e.g.
+	 * when it was exported through a sync_file or dma-buf, and so after
+	 * the engine itself has been freed. i915_gem_request_pools_close()
+	 * waits for us to finish with the engine before letting it go.
+	 */
+	rcu_read_lock();
+	if (unlikely(READ_ONCE(req->i915->gt.request_pools_closed)))
+		goto free;
+
+	if (atomic_inc_return(&engine->request_pool.count) >
+	    I915_REQUEST_POOL_SIZE) {
+		atomic_dec(&engine->request_pool.count);
+		goto free;
+	}
+
+	llist_add(&req->free_link, &engine->request_pool.free);
+	rcu_read_unlock();
+	return;
+
+free:
+	rcu_read_unlock();
+	kmem_cache_free(req->i915->requests, req);
+}
+
+static struct drm_i915_gem_request *
+request_pool_get(struct intel_engine_cs *engine)
+{
+	struct llist_node *first;
+
+	/* Only a single consumer is allowed for llist_del_first() */
+	lockdep_assert_held(&engine->i915->drm.struct_mutex);
+
+	first = llist_del_first(&engine->request_pool.free);
+	if (!first)
+		return NULL;
+
+	atomic_dec(&engine->request_pool.count);
+	return llist_entry(first, struct drm_i915_gem_request, free_link);
+}
+
+/**
+ * i915_gem_request_pool_trim - return the engine's stashed requests to the slab
+ * @engine: the engine whose pool to empty
+ *
+ * Called when the engine is parked or torn down, so that we do not hold on
+ * to memory we are not using.
+ */
+void i915_gem_request_pool_trim(struct intel_engine_cs *engine)
+{
+	struct drm_i915_gem_request *req, *next;
+	struct llist_node *freed;
+
+	freed = llist_del_all(&engine->request_pool.free);
+	llist_for_each_entry_safe(req, next, freed, free_link) {
+		atomic_dec(&engine->request_pool.count);
+		kmem_cache_free(engine->i915->requests, req);
+	}
+}
+
+/**
+ * i915_gem_request_pools_close - stop recycling requests through the engines
+ * @i915: the device
+ *
+ * Called before the engines are freed. Released requests are returned
+ * straight to the slab from now on, and the pools are emptied once no
+ * request_pool_put() can still be looking at an engine.
+ */
+void i915_gem_request_pools_close(struct drm_i915_private *i915)
+{
+	struct intel_engine_cs *engine;
+	enum intel_engine_id id;
+
+	WRITE_ONCE(i915->gt.request_pools_closed, true);
+	synchronize_rcu();
+
+	for_each_engine(engine, i915, id)
+		i915_gem_request_pool_trim(engine);
+}
+
 static void i915_fence_release(struct dma_fence *fence)
 {
 	struct drm_i915_gem_request *req = to_request(fence);
@@ -89,7 +183,7 @@ static void i915_fence_release(struct dma_fence *fence)
 	 */
 	i915_sw_fence_fini(&req->submit);
 
-	kmem_cache_free(req->i915->requests, req);
+	request_pool_put(req);
 }
 
 const struct dma_fence_ops i915_fence_ops = {
@@ -655,11 +749,19 @@ i915_gem_request_alloc(struct intel_engine_cs *engine,
 	if (ret)
 		goto err_unreserve;
 
-	/* Move the oldest request to the slab-cache (if not in use!) */
-	req = list_first_entry_or_null(&engine->timeline->requests,
-				       typeof(*req), link);
-	if (req && i915_gem_request_completed(req))
+	/*
+	 * Move the oldest completed requests to the request pool (if not in
+	 * use!). Retiring them in a batch, rather than just the oldest,
+	 * keeps the pool stocked for a client submitting back-to-back.
+	 */
+	do {
+		req = list_first_entry_or_null(&engine->timeline->requests,
+					       typeof(*req), link);
+		if (!req || !i915_gem_request_completed(req))
+			break;
+
 		i915_gem_request_retire(req);
+	} while (1);
 
 	/* Beware: Dragons be flying overhead.
 	 *
@@ -688,9 +790,15 @@ i915_gem_request_alloc(struct intel_engine_cs *engine,
 	 * active request - which it won't be and restart the lookup.
 	 *
 	 * Do not use kmem_cache_zalloc() here!
+	 *
+	 * The same applies to requests recycled from the engine's pool.
 	 */
-	req = kmem_cache_alloc(dev_priv->requests,
-			       GFP_KERNEL | __GFP_RETRY_MAYFAIL | __GFP_NOWARN);
+	req = request_pool_get(engine);
+	if (!req)
+		req = kmem_cache_alloc(dev_priv->requests,
+				       GFP_KERNEL |
+				       __GFP_RETRY_MAYFAIL |
+				       __GFP_NOWARN);
 	if (unlikely(!req)) {
 		/* Ratelimit ourselves to prevent oom from malicious clients */
 		ret = i915_gem_wait_for_idle(dev_priv,
@@ -774,7 +882,7 @@ err_unwind:
 	GEM_BUG_ON(!list_empty(&req->priotree.signalers_list));
 	GEM_BUG_ON(!list_empty(&req->priotree.waiters_list));
 
-	kmem_cache_free(dev_priv->requests, req);
+	request_pool_put(req);
 err_unreserve:
 	unreserve_engine(engine);
 err_unpin:
@@ -1150,6 +1258,52 @@ static bool __i915_spin_request(const struct drm_i915_gem_request *req,
 	return false;
 }
 
+/*
+ * Spinning is worthwhile only if the request is likely to complete sooner
+ * than it takes to arm the interrupt and sleep. We keep a running average
+ * (1/8 weight) of the time from a started request being waited upon to its
+ * completion, and spin for up to twice that. If a typical request on this
+ * engine takes longer than I915_SPIN_MAX_US, we do not spin at all, except
+ * for an occasional probe so that the average can recover once the workload
+ * changes (the samples taken after sleeping include the interrupt latency and
+ * so overestimate). Until we have any history, use the old fixed spin.
+ */
+#define I915_SPIN_DEFAULT_US 5
+#define I915_SPIN_MAX_US 20
+#define I915_SPIN_PROBE_INTERVAL 16
+
+static unsigned long spin_timeout_us(struct intel_engine_cs *engine)
+{
+	unsigned long avg = READ_ONCE(engine->spin.avg_ns);
+
+	if (!avg)
+		return I915_SPIN_DEFAULT_US;
+
+	avg >>= 10; /* approximate microseconds, as local_clock_us() */
+	if (avg > I915_SPIN_MAX_US) {
+		if (++engine->spin.skipped % I915_SPIN_PROBE_INTERVAL)
+			return 0;
+
+		return I915_SPIN_DEFAULT_US;
+	}
+
+	return clamp_t(unsigned long, 2 * avg, 1, I915_SPIN_MAX_US);
+}
+
+static void spin_update(struct intel_engine_cs *engine, u64 start)
+{
+	long avg = READ_ONCE(engine->spin.avg_ns);
+	long sample = min_t(u64, local_clock() - start, LONG_MAX / 2);
+
+	if (avg)
+		avg += (sample - avg) / 8;
+	else
+		avg = sample;
+
+	/* Zero is reserved for "no history yet" */
+	WRITE_ONCE(engine->spin.avg_ns, max(avg, 1L));
+}
+
 static bool __i915_wait_request_check_and_reset(struct drm_i915_gem_request *request)
 {
 	if (likely(!i915_reset_handoff(&request->i915->gpu_error)))
@@ -1188,7 +1342,9 @@ long i915_wait_request(struct drm_i915_gem_request *req,
 	wait_queue_head_t *errq = &req->i915->gpu_error.wait_queue;
 	DEFINE_WAIT_FUNC(reset, default_wake_function);
 	DEFINE_WAIT_FUNC(exec, default_wake_function);
+	struct intel_engine_cs *engine;
 	struct intel_wait wait;
+	u64 spin_start;
 
 	might_sleep();
 #ifndef __linux__
@@ -1243,9 +1399,27 @@ restart:
 	GEM_BUG_ON(!intel_wait_has_seqno(&wait));
 	GEM_BUG_ON(!i915_sw_fence_signaled(&req->submit));
 
-	/* Optimistic short spin before touching IRQs */
-	if (__i915_spin_request(req, wait.seqno, state, 5))
-		goto complete;
+	/*
+	 * Optimistic short spin before touching IRQs, if the request has
+	 * already started and requests on this engine usually complete
+	 * quickly once they have.
+	 */
+	engine = req->engine;
+	spin_start = 0;
+	if (i915_seqno_passed(intel_engine_get_seqno(engine), wait.seqno - 1)) {
+		unsigned long timeout_us = spin_timeout_us(engine);
+
+		spin_start = local_clock();
+		if (timeout_us) {
+			if (__i915_spin_request(req, wait.seqno,
+						state, timeout_us)) {
+				atomic_inc(&engine->spin.hits);
+				spin_update(engine, spin_start);
+				goto complete;
+			}
+			atomic_inc(&engine->spin.misses);
+		}
+	}
 
 	set_current_state(state);
 	if (intel_engine_add_wait(req->engine, &wait))
@@ -1311,6 +1485,8 @@ wakeup:
 	}
 
 	intel_engine_remove_wait(req->engine, &wait);
+	if (spin_start && timeout >= 0)
+		spin_update(engine, spin_start);
 complete:
 	__set_current_state(TASK_RUNNING);
 	if (flags & I915_WAIT_LOCKED)
@@ -1341,6 +1517,44 @@ static void engine_retire_requests(struct intel_engine_cs *engine)
 		i915_gem_request_retire(request);
 }
 
+void i915_gem_engine_retire_work_handler(struct work_struct *work)
+{
+	struct intel_engine_cs *engine =
+		container_of(work, typeof(*engine), retire_work.work);
+	struct drm_i915_private *i915 = engine->i915;
+
+	/*
+	 * If the device is busy, come back shortly rather than leaving the
+	 * signaled requests to the next tick of gt.retire_work.
+	 */
+	if (!mutex_trylock(&i915->drm.struct_mutex)) {
+		if (READ_ONCE(i915->gt.active_requests))
+			schedule_delayed_work(&engine->retire_work, 1);
+		return;
+	}
+
+	if (i915->gt.active_requests)
+		engine_retire_requests(engine);
+
+	mutex_unlock(&i915->drm.struct_mutex);
+}
+
+/**
+ * i915_gem_queue_retire - retire the engine's completed requests shortly
+ * @engine: the engine whose requests have just been signaled
+ *
+ * Called from the breadcrumb signaling path, which cannot take struct_mutex
+ * itself. Repeated calls before the worker runs are coalesced.
+ *
+ * The worker runs on the system workqueue rather than i915->wq: that one is
+ * ordered, so retirements would queue up behind unrelated work, and it is
+ * drained on unload while the signaler may still be queueing retirements.
+ */
+void i915_gem_queue_retire(struct intel_engine_cs *engine)
+{
+	schedule_delayed_work(&engine->retire_work, 0);
+}
+
 void i915_gem_retire_requests(struct drm_i915_private *dev_priv)
 {
 	struct intel_engine_cs *engine;
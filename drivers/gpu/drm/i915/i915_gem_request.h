@@ -26,6 +26,7 @@
 #define I915_GEM_REQUEST_H
 
 #include <linux/dma-fence.h>
+#include <linux/llist.h>
 #ifndef __linux__
 #include <linux/lockdep.h>
 #endif
@@ -205,6 +206,9 @@ struct drm_i915_gem_request {
 	struct drm_i915_file_private *file_priv;
 	/** file_priv list entry for this request */
 	struct list_head client_link;
+
+	/** engine->request_pool entry once the request is released */
+	struct llist_node free_link;
 };
 
 #define I915_FENCE_GFP (GFP_KERNEL | __GFP_RETRY_MAYFAIL | __GFP_NOWARN)
@@ -220,6 +224,8 @@ struct drm_i915_gem_request * __must_check
 i915_gem_request_alloc(struct intel_engine_cs *engine,
 		       struct i915_gem_context *ctx);
 void i915_gem_request_retire_upto(struct drm_i915_gem_request *req);
+void i915_gem_request_pool_trim(struct intel_engine_cs *engine);
+void i915_gem_request_pools_close(struct drm_i915_private *i915);
 
 static inline struct drm_i915_gem_request *
 to_request(struct dma_fence *fence)
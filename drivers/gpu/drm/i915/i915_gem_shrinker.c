@@ -35,6 +35,12 @@
 #include "i915_drv.h"
 #include "i915_trace.h"
 
+/* Objects the I915_SHRINK_LARGE pass considers worth reclaiming first */
+#define SHRINK_LARGE_SIZE (2 << 20)
+
+/* How much the shrink worker releases before dropping struct_mutex */
+#define SHRINK_WORK_CHUNK 1024 /* pages */
+
 static bool shrinker_lock(struct drm_i915_private *i915, bool *unlock)
 {
 	switch (mutex_trylock_recursive(&i915->drm.struct_mutex)) {
@@ -236,6 +242,10 @@ i915_gem_shrink(struct drm_i915_private *i915,
 			    !is_vmalloc_addr(obj->mm.mapping))
 				continue;
 
+			if (flags & I915_SHRINK_LARGE &&
+			    obj->base.size < SHRINK_LARGE_SIZE)
+				continue;
+
 			if (!(flags & I915_SHRINK_ACTIVE) &&
 			    (i915_gem_object_is_active(obj) ||
 			     i915_gem_object_is_framebuffer(obj)))
@@ -244,6 +254,14 @@ i915_gem_shrink(struct drm_i915_private *i915,
 			if (!can_release_pages(obj))
 				continue;
 
+			/*
+			 * A GTT fault may be remapping this object without
+			 * struct_mutex, and may itself have brought us into
+			 * reclaim: revoking its mmap would wait upon it.
+			 */
+			if (mutex_is_locked(&obj->userfault_lock))
+				continue;
+
 			spin_unlock(&i915->mm.obj_lock);
 
 			if (unsafe_drop_pages(obj)) {
@@ -304,6 +322,84 @@ unsigned long i915_gem_shrink_all(struct drm_i915_private *i915)
 	return freed;
 }
 
+static unsigned long
+i915_gem_shrinker_count(struct shrinker *shrinker, struct shrink_control *sc);
+
+/*
+ * The shrink worker releases the pages direct reclaim asked for but did not
+ * want to wait for, largest (and so cheapest per page) idle objects first,
+ * each in least-recently-used order. It only holds struct_mutex for a chunk
+ * of SHRINK_WORK_CHUNK pages at a time so that clients are not locked out of
+ * the GPU for the whole scan.
+ */
+static void i915_gem_shrinker_worker(struct work_struct *work)
+{
+	struct drm_i915_private *i915 =
+		container_of(work, typeof(*i915), mm.shrink_work);
+	long pending;
+
+	while ((pending = atomic_long_read(&i915->mm.shrink_pending)) > 0) {
+		unsigned long target, freed, scanned = 0;
+
+		/*
+		 * Memory may have been released elsewhere since reclaim gave
+		 * up on us, so never chase more than we could free right now.
+		 */
+		pending = min_t(long, pending,
+				i915_gem_shrinker_count(&i915->mm.shrinker,
+							NULL));
+		target = min_t(long, pending, SHRINK_WORK_CHUNK);
+		if (!target) {
+			atomic_long_set(&i915->mm.shrink_pending, 0);
+			break;
+		}
+
+		mutex_lock(&i915->drm.struct_mutex);
+		freed = i915_gem_shrink(i915, target, &scanned,
+					I915_SHRINK_BOUND |
+					I915_SHRINK_UNBOUND |
+					I915_SHRINK_LARGE);
+		if (freed < target)
+			freed += i915_gem_shrink(i915, target - freed, &scanned,
+						 I915_SHRINK_BOUND |
+						 I915_SHRINK_UNBOUND);
+		mutex_unlock(&i915->drm.struct_mutex);
+
+		/* Nothing left that we can release, forget the rest */
+		if (!scanned) {
+			atomic_long_set(&i915->mm.shrink_pending, 0);
+			break;
+		}
+
+		atomic_long_set(&i915->mm.shrink_pending, pending - target);
+		cond_resched();
+	}
+}
+
+static void i915_gem_shrinker_defer(struct drm_i915_private *i915,
+				    unsigned long target)
+{
+	long pending = atomic_long_read(&i915->mm.shrink_pending);
+
+	/*
+	 * Every deferral restates how far reclaim is still short, and the
+	 * same shortfall is reported again on each pass until it is met.
+	 * Keep the largest outstanding request rather than adding them up,
+	 * or a burst of contended scans would have the worker evict far more
+	 * than was ever asked for.
+	 */
+	while (pending < (long)target) {
+		long old = atomic_long_cmpxchg(&i915->mm.shrink_pending,
+					       pending, target);
+		if (old == pending)
+			break;
+
+		pending = old;
+	}
+
+	queue_work(system_unbound_wq, &i915->mm.shrink_work);
+}
+
 static unsigned long
 i915_gem_shrinker_count(struct shrinker *shrinker, struct shrink_control *sc)
 {
@@ -341,7 +437,7 @@ i915_gem_shrinker_count(struct shrinker *shrinker, struct shrink_control *sc)
 			    128ul /* default SHRINK_BATCH */);
 	}
 
-	return count;
+	return count + READ_ONCE(i915->mm.pt_cache_count);
 }
 
 static unsigned long
@@ -354,22 +450,49 @@ i915_gem_shrinker_scan(struct shrinker *shrinker, struct shrink_control *sc)
 
 	sc->nr_scanned = 0;
 
-	if (!shrinker_lock(i915, &unlock))
+	if (!shrinker_lock(i915, &unlock)) {
+		/* Someone else is busy with the GPU, leave it to the worker */
+		i915_gem_shrinker_defer(i915, sc->nr_to_scan);
 		return SHRINK_STOP;
+	}
+
+	/* Unused page tables are the cheapest of all to give back */
+	freed = i915_ppgtt_shrink_cache(i915, sc->nr_to_scan);
+	sc->nr_scanned += freed;
+
+	if (sc->nr_scanned < sc->nr_to_scan)
+		freed += i915_gem_shrink(i915,
+					 sc->nr_to_scan - sc->nr_scanned,
+					 &sc->nr_scanned,
+					 I915_SHRINK_BOUND |
+					 I915_SHRINK_UNBOUND |
+					 I915_SHRINK_PURGEABLE);
+
+	/*
+	 * Discarding purgeable objects is cheap, but releasing the pages of
+	 * bound objects requires unbinding them from the GTT and so keeps
+	 * struct_mutex (and any client waiting on it) for much longer. Only
+	 * kswapd does that here; in direct reclaim we release what we can
+	 * from the unbound list and pass the remainder on to the worker.
+	 */
+	if (sc->nr_scanned < sc->nr_to_scan && !current_is_kswapd()) {
+		freed += i915_gem_shrink(i915,
+					 sc->nr_to_scan - sc->nr_scanned,
+					 &sc->nr_scanned,
+					 I915_SHRINK_UNBOUND);
+		if (sc->nr_scanned < sc->nr_to_scan)
+			i915_gem_shrinker_defer(i915,
+						sc->nr_to_scan - sc->nr_scanned);
+		goto out;
+	}
 
-	freed = i915_gem_shrink(i915,
-				sc->nr_to_scan,
-				&sc->nr_scanned,
-				I915_SHRINK_BOUND |
-				I915_SHRINK_UNBOUND |
-				I915_SHRINK_PURGEABLE);
 	if (sc->nr_scanned < sc->nr_to_scan)
 		freed += i915_gem_shrink(i915,
 					 sc->nr_to_scan - sc->nr_scanned,
 					 &sc->nr_scanned,
 					 I915_SHRINK_BOUND |
 					 I915_SHRINK_UNBOUND);
-	if (sc->nr_scanned < sc->nr_to_scan && current_is_kswapd()) {
+	if (sc->nr_scanned < sc->nr_to_scan) {
 		intel_runtime_pm_get(i915);
 		freed += i915_gem_shrink(i915,
 					 sc->nr_to_scan - sc->nr_scanned,
@@ -380,6 +503,7 @@ i915_gem_shrinker_scan(struct shrinker *shrinker, struct shrink_control *sc)
 		intel_runtime_pm_put(i915);
 	}
 
+out:
 	shrinker_unlock(i915, unlock);
 
 	return sc->nr_scanned ? freed : SHRINK_STOP;
@@ -505,6 +629,8 @@ void i915_gem_shrinker_register(struct drm_i915_private *i915)
 	i915->mm.shrinker.count_objects = i915_gem_shrinker_count;
 	i915->mm.shrinker.seeks = DEFAULT_SEEKS;
 	i915->mm.shrinker.batch = 4096;
+	atomic_long_set(&i915->mm.shrink_pending, 0);
+	INIT_WORK(&i915->mm.shrink_work, i915_gem_shrinker_worker);
 	WARN_ON(register_shrinker(&i915->mm.shrinker));
 
 	i915->mm.oom_notifier.notifier_call = i915_gem_shrinker_oom;
@@ -529,4 +655,5 @@ void i915_gem_shrinker_unregister(struct drm_i915_private *i915)
 #endif
 	WARN_ON(unregister_oom_notifier(&i915->mm.oom_notifier));
 	unregister_shrinker(&i915->mm.shrinker);
+	cancel_work_sync(&i915->mm.shrink_work);
 }
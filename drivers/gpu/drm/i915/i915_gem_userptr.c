@@ -58,40 +58,100 @@ struct i915_mmu_object {
 	struct drm_i915_gem_object *obj;
 	struct interval_tree_node it;
 	struct list_head link;
-	struct work_struct work;
 	bool attached;
+	bool cancelling;
+	bool cancel_again;
 };
 
-static void cancel_userptr(struct work_struct *work)
+/*
+ * All the objects overlapping a single invalidation are cancelled together
+ * by one work item, so that a munmap() covering many userptr objects costs
+ * one trip through the workqueue and one acquisition of struct_mutex rather
+ * than one of each per object.
+ */
+struct i915_mmu_cancel {
+	struct work_struct work;
+	struct list_head objects;
+};
+
+static void __cancel_userptrs(struct list_head *objects)
 {
-	struct i915_mmu_object *mo = container_of(work, typeof(*mo), work);
-	struct drm_i915_gem_object *obj = mo->obj;
-	struct work_struct *active;
+	struct i915_mmu_object *mo, *next;
+	struct drm_device *dev = NULL;
+	LIST_HEAD(done);
+
+	list_for_each_entry_safe(mo, next, objects, link) {
+		struct drm_i915_gem_object *obj = mo->obj;
+		struct work_struct *active;
+
+		/* Cancel any active worker and force us to re-evaluate gup */
+		mutex_lock(&obj->mm.lock);
+		active = fetch_and_zero(&obj->userptr.work);
+		mutex_unlock(&obj->mm.lock);
+		if (active) {
+			list_move(&mo->link, &done);
+			continue;
+		}
 
-	/* Cancel any active worker and force us to re-evaluate gup */
-	mutex_lock(&obj->mm.lock);
-	active = fetch_and_zero(&obj->userptr.work);
-	mutex_unlock(&obj->mm.lock);
-	if (active)
-		goto out;
+		i915_gem_object_wait(obj, I915_WAIT_ALL,
+				     MAX_SCHEDULE_TIMEOUT, NULL);
+		dev = obj->base.dev;
+	}
 
-	i915_gem_object_wait(obj, I915_WAIT_ALL, MAX_SCHEDULE_TIMEOUT, NULL);
+	if (dev) {
+		mutex_lock(&dev->struct_mutex);
+		list_for_each_entry(mo, objects, link) {
+			struct drm_i915_gem_object *obj = mo->obj;
+
+			/* We are inside a kthread context and can't be interrupted */
+			if (i915_gem_object_unbind(obj) == 0)
+				__i915_gem_object_put_pages(obj, I915_MM_NORMAL);
+			WARN_ONCE(i915_gem_object_has_pages(obj),
+				  "Failed to release pages: bind_count=%d, pages_pin_count=%d, pin_global=%d\n",
+				  obj->bind_count,
+				  atomic_read(&obj->mm.pages_pin_count),
+				  obj->pin_global);
+		}
+		mutex_unlock(&dev->struct_mutex);
+	}
 
-	mutex_lock(&obj->base.dev->struct_mutex);
+	list_splice(&done, objects);
+}
 
-	/* We are inside a kthread context and can't be interrupted */
-	if (i915_gem_object_unbind(obj) == 0)
-		__i915_gem_object_put_pages(obj, I915_MM_NORMAL);
-	WARN_ONCE(i915_gem_object_has_pages(obj),
-		  "Failed to release pages: bind_count=%d, pages_pin_count=%d, pin_global=%d\n",
-		  obj->bind_count,
-		  atomic_read(&obj->mm.pages_pin_count),
-		  obj->pin_global);
+static void cancel_userptrs(struct work_struct *work)
+{
+	struct i915_mmu_cancel *cancel = container_of(work, typeof(*cancel), work);
+	struct i915_mmu_object *mo, *next;
+	LIST_HEAD(again);
 
-	mutex_unlock(&obj->base.dev->struct_mutex);
+	do {
+		__cancel_userptrs(&cancel->objects);
 
-out:
-	i915_gem_object_put(obj);
+		/*
+		 * An invalidation that arrived while we were cancelling an
+		 * object skipped it, as it is still on our list, and relies
+		 * on us. The object may have acquired new pages since our
+		 * pass, so cancel it once more before letting it go.
+		 */
+		list_for_each_entry_safe(mo, next, &cancel->objects, link) {
+			bool retry;
+
+			spin_lock(&mo->mn->lock);
+			retry = fetch_and_zero(&mo->cancel_again);
+			if (retry) {
+				list_move_tail(&mo->link, &again);
+			} else {
+				list_del(&mo->link);
+				mo->cancelling = false;
+			}
+			spin_unlock(&mo->mn->lock);
+
+			if (!retry)
+				i915_gem_object_put(mo->obj);
+		}
+
+		list_splice_init(&again, &cancel->objects);
+	} while (!list_empty(&cancel->objects));
 }
 
 static void add_object(struct i915_mmu_object *mo)
@@ -119,9 +179,9 @@ static void i915_gem_userptr_mn_invalidate_range_start(struct mmu_notifier *_mn,
 {
 	struct i915_mmu_notifier *mn =
 		container_of(_mn, struct i915_mmu_notifier, mn);
-	struct i915_mmu_object *mo;
+	struct i915_mmu_cancel cancel;
 	struct interval_tree_node *it;
-	LIST_HEAD(cancelled);
+	bool found = false, queued;
 
 	if (RB_EMPTY_ROOT(&mn->objects.rb_root))
 		return;
@@ -129,9 +189,18 @@ static void i915_gem_userptr_mn_invalidate_range_start(struct mmu_notifier *_mn,
 	/* interval ranges are inclusive, but invalidate range is exclusive */
 	end--;
 
+	INIT_LIST_HEAD(&cancel.objects);
+
+	/*
+	 * Detach every overlapping object in a single pass under the lock.
+	 * As we remove each object from the tree as we go, we simply keep
+	 * taking the first remaining overlap.
+	 */
 	spin_lock(&mn->lock);
-	it = interval_tree_iter_first(&mn->objects, start, end);
-	while (it) {
+	while ((it = interval_tree_iter_first(&mn->objects, start, end))) {
+		struct i915_mmu_object *mo =
+			container_of(it, struct i915_mmu_object, it);
+
 		/* The mmu_object is released late when destroying the
 		 * GEM object so it is entirely possible to gain a
 		 * reference on an object in the process of being freed
@@ -140,20 +209,34 @@ static void i915_gem_userptr_mn_invalidate_range_start(struct mmu_notifier *_mn,
 		 * is freed and then double free it. To prevent that
 		 * use-after-free we only acquire a reference on the
 		 * object if it is not in the process of being destroyed.
+		 *
+		 * If the object is still being cancelled by an earlier
+		 * invalidation, ask that worker for another pass over it,
+		 * which we wait for when we flush the workqueue below.
 		 */
-		mo = container_of(it, struct i915_mmu_object, it);
-		if (kref_get_unless_zero(&mo->obj->base.refcount))
-			queue_work(mn->wq, &mo->work);
+		if (mo->cancelling) {
+			mo->cancel_again = true;
+		} else if (kref_get_unless_zero(&mo->obj->base.refcount)) {
+			mo->cancelling = true;
+			list_add_tail(&mo->link, &cancel.objects);
+		}
 
-		list_add(&mo->link, &cancelled);
-		it = interval_tree_iter_next(it, start, end);
-	}
-	list_for_each_entry(mo, &cancelled, link)
 		del_object(mo);
+		found = true;
+	}
 	spin_unlock(&mn->lock);
 
-	if (!list_empty(&cancelled))
+	queued = !list_empty(&cancel.objects);
+	if (queued) {
+		INIT_WORK_ONSTACK(&cancel.work, cancel_userptrs);
+		queue_work(mn->wq, &cancel.work);
+	}
+
+	if (found)
 		flush_workqueue(mn->wq);
+
+	if (queued)
+		destroy_work_on_stack(&cancel.work);
 }
 
 static const struct mmu_notifier_ops i915_gem_userptr_notifier = {
@@ -266,7 +349,6 @@ i915_gem_userptr_init__mmu_notifier(struct drm_i915_gem_object *obj,
 	mo->obj = obj;
 	mo->it.start = obj->userptr.ptr;
 	mo->it.last = obj->userptr.ptr + obj->base.size - 1;
-	INIT_WORK(&mo->work, cancel_userptr);
 
 	obj->userptr.mmu_object = mo;
 	return 0;
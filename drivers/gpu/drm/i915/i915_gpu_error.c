@@ -196,11 +196,27 @@ i915_error_printer(struct drm_i915_error_state_buf *e)
 	return p;
 }
 
+static int capture_page(void *src, struct drm_i915_error_object *dst)
+{
+	unsigned long page;
+	void *ptr;
+
+	page = __get_free_page(GFP_ATOMIC | __GFP_NOWARN);
+	if (!page)
+		return -ENOMEM;
+
+	ptr = (void *)page;
+	if (!i915_memcpy_from_wc(ptr, src, PAGE_SIZE))
+		memcpy(ptr, src, PAGE_SIZE);
+	dst->pages[dst->page_count++] = ptr;
+
+	return 0;
+}
+
 #ifdef CONFIG_DRM_I915_COMPRESS_ERROR
 
 struct compress {
 	struct z_stream_s zstream;
-	void *tmp;
 };
 
 static bool compress_init(struct compress *c)
@@ -209,7 +225,7 @@ static bool compress_init(struct compress *c)
 
 	zstream->workspace =
 		kmalloc(zlib_deflate_workspacesize(MAX_WBITS, MAX_MEM_LEVEL),
-			GFP_ATOMIC | __GFP_NOWARN);
+			GFP_KERNEL | __GFP_NOWARN);
 	if (!zstream->workspace)
 		return false;
 
@@ -218,10 +234,6 @@ static bool compress_init(struct compress *c)
 		return false;
 	}
 
-	c->tmp = NULL;
-	if (i915_has_memcpy_from_wc())
-		c->tmp = (void *)__get_free_page(GFP_ATOMIC | __GFP_NOWARN);
-
 	return true;
 }
 
@@ -232,15 +244,13 @@ static int compress_page(struct compress *c,
 	struct z_stream_s *zstream = &c->zstream;
 
 	zstream->next_in = src;
-	if (c->tmp && i915_memcpy_from_wc(c->tmp, src, PAGE_SIZE))
-		zstream->next_in = c->tmp;
 	zstream->avail_in = PAGE_SIZE;
 
 	do {
 		if (zstream->avail_out == 0) {
 			unsigned long page;
 
-			page = __get_free_page(GFP_ATOMIC | __GFP_NOWARN);
+			page = __get_free_page(GFP_KERNEL | __GFP_NOWARN);
 			if (!page)
 				return -ENOMEM;
 
@@ -273,48 +283,66 @@ static void compress_fini(struct compress *c,
 
 	zlib_deflateEnd(zstream);
 	kfree(zstream->workspace);
-
-	if (c->tmp)
-		free_page((unsigned long)c->tmp);
 }
 
-static void err_compression_marker(struct drm_i915_error_state_buf *m)
+/*
+ * Deflate the raw snapshot taken during capture into a new object. This
+ * runs from a worker, outside of stop_machine, so it may sleep.
+ */
+static struct drm_i915_error_object *
+compress_object(struct drm_i915_error_object *src)
 {
-	err_puts(m, ":");
-}
+	struct drm_i915_error_object *dst;
+	struct compress compress;
+	unsigned long num_pages;
+	int page;
 
-#else
+	num_pages = DIV_ROUND_UP(10 * src->page_count, 8); /* worstcase zlib growth */
+	dst = kmalloc(sizeof(*dst) + num_pages * sizeof(u32 *),
+		      GFP_KERNEL | __GFP_NOWARN);
+	if (!dst)
+		return NULL;
 
-struct compress {
-};
+	dst->gtt_offset = src->gtt_offset;
+	dst->gtt_size = src->gtt_size;
+	dst->page_count = 0;
+	dst->unused = 0;
 
-static bool compress_init(struct compress *c)
-{
-	return true;
-}
+	if (!compress_init(&compress)) {
+		kfree(dst);
+		return NULL;
+	}
 
-static int compress_page(struct compress *c,
-			 void *src,
-			 struct drm_i915_error_object *dst)
-{
-	unsigned long page;
-	void *ptr;
+	for (page = 0; page < src->page_count; page++) {
+		if (compress_page(&compress, src->pages[page], dst))
+			goto unwind;
 
-	page = __get_free_page(GFP_ATOMIC | __GFP_NOWARN);
-	if (!page)
-		return -ENOMEM;
+		cond_resched();
+	}
+	goto out;
 
-	ptr = (void *)page;
-	if (!i915_memcpy_from_wc(ptr, src, PAGE_SIZE))
-		memcpy(ptr, src, PAGE_SIZE);
-	dst->pages[dst->page_count++] = ptr;
+unwind:
+	while (dst->page_count--)
+		free_page((unsigned long)dst->pages[dst->page_count]);
+	kfree(dst);
+	dst = NULL;
 
-	return 0;
+out:
+	compress_fini(&compress, dst);
+	return dst;
 }
 
-static void compress_fini(struct compress *c,
-			  struct drm_i915_error_object *dst)
+static void err_compression_marker(struct drm_i915_error_state_buf *m)
 {
+	err_puts(m, ":");
+}
+
+#else
+
+static struct drm_i915_error_object *
+compress_object(struct drm_i915_error_object *src)
+{
+	return src;
 }
 
 static void err_compression_marker(struct drm_i915_error_state_buf *m)
@@ -873,6 +901,8 @@ void __i915_gpu_state_free(struct kref *error_ref)
 		container_of(error_ref, typeof(*error), ref);
 	long i, j;
 
+	wait_for_completion(&error->compressed);
+
 	for (i = 0; i < ARRAY_SIZE(error->engine); i++) {
 		struct drm_i915_error_engine *ee = &error->engine[i];
 
@@ -912,7 +942,6 @@ i915_error_object_create(struct drm_i915_private *i915,
 	struct i915_ggtt *ggtt = &i915->ggtt;
 	const u64 slot = ggtt->error_capture.start;
 	struct drm_i915_error_object *dst;
-	struct compress compress;
 	unsigned long num_pages;
 	struct sgt_iter iter;
 	dma_addr_t dma;
@@ -921,7 +950,6 @@ i915_error_object_create(struct drm_i915_private *i915,
 		return NULL;
 
 	num_pages = min_t(u64, vma->size, vma->obj->base.size) >> PAGE_SHIFT;
-	num_pages = DIV_ROUND_UP(10 * num_pages, 8); /* worstcase zlib growth */
 	dst = kmalloc(sizeof(*dst) + num_pages * sizeof(u32 *),
 		      GFP_ATOMIC | __GFP_NOWARN);
 	if (!dst)
@@ -932,11 +960,10 @@ i915_error_object_create(struct drm_i915_private *i915,
 	dst->page_count = 0;
 	dst->unused = 0;
 
-	if (!compress_init(&compress)) {
-		kfree(dst);
-		return NULL;
-	}
-
+	/*
+	 * Only take a raw copy of each page here, we are still inside
+	 * stop_machine. Compression is deferred to i915_gpu_state_compress().
+	 */
 	for_each_sgt_dma(dma, iter, vma->pages) {
 		void __iomem *s;
 		int ret;
@@ -945,7 +972,7 @@ i915_error_object_create(struct drm_i915_private *i915,
 				       I915_CACHE_NONE, 0);
 
 		s = io_mapping_map_atomic_wc(&ggtt->iomap, slot);
-		ret = compress_page(&compress, (void  __force *)s, dst);
+		ret = capture_page((void  __force *)s, dst);
 		io_mapping_unmap_atomic(s);
 
 		if (ret)
@@ -960,7 +987,6 @@ unwind:
 	dst = NULL;
 
 out:
-	compress_fini(&compress, dst);
 	ggtt->base.clear_range(&ggtt->base, slot, PAGE_SIZE);
 	return dst;
 }
@@ -1764,6 +1790,87 @@ static int capture(void *data)
 	return 0;
 }
 
+struct compress_work {
+	struct work_struct work;
+	struct i915_gpu_state *error;
+	struct drm_i915_error_object **slot;
+};
+
+static void compress_worker(struct work_struct *work)
+{
+	struct compress_work *cw = container_of(work, typeof(*cw), work);
+	struct i915_gpu_state *error = cw->error;
+	struct drm_i915_error_object *src = *cw->slot;
+	struct drm_i915_error_object *dst;
+
+	dst = compress_object(src);
+	if (dst != src)
+		i915_error_object_free(src);
+	*cw->slot = dst;
+	kfree(cw);
+
+	if (atomic_dec_and_test(&error->pending))
+		complete_all(&error->compressed);
+}
+
+static void queue_compress(struct i915_gpu_state *error,
+			   struct drm_i915_error_object **slot)
+{
+	struct compress_work *cw;
+
+	if (!IS_ENABLED(CONFIG_DRM_I915_COMPRESS_ERROR) || !*slot)
+		return;
+
+	cw = kmalloc(sizeof(*cw), GFP_KERNEL | __GFP_NOWARN);
+	if (!cw) {
+		/* Never leave an uncompressed object behind a ':' marker */
+		i915_error_object_free(*slot);
+		*slot = NULL;
+		return;
+	}
+
+	INIT_WORK(&cw->work, compress_worker);
+	cw->error = error;
+	cw->slot = slot;
+
+	atomic_inc(&error->pending);
+	queue_work(system_unbound_wq, &cw->work);
+}
+
+/*
+ * Hand each captured object to its own worker so that the objects are
+ * compressed in parallel, and off the reset path. Readers of the error
+ * state wait upon error->compressed before looking at the objects.
+ */
+static void i915_gpu_state_compress(struct i915_gpu_state *error)
+{
+	long i, j;
+
+	/* Hold a bias so that we cannot complete before all are queued */
+	atomic_set(&error->pending, 1);
+	init_completion(&error->compressed);
+
+	for (i = 0; i < ARRAY_SIZE(error->engine); i++) {
+		struct drm_i915_error_engine *ee = &error->engine[i];
+
+		for (j = 0; j < ee->user_bo_count; j++)
+			queue_compress(error, &ee->user_bo[j]);
+
+		queue_compress(error, &ee->batchbuffer);
+		queue_compress(error, &ee->wa_batchbuffer);
+		queue_compress(error, &ee->ringbuffer);
+		queue_compress(error, &ee->hws_page);
+		queue_compress(error, &ee->ctx);
+		queue_compress(error, &ee->wa_ctx);
+		queue_compress(error, &ee->default_state);
+	}
+
+	queue_compress(error, &error->uc.guc_log);
+
+	if (atomic_dec_and_test(&error->pending))
+		complete_all(&error->compressed);
+}
+
 #define DAY_AS_SECONDS(x) (24 * 60 * 60 * (x))
 
 struct i915_gpu_state *
@@ -1779,6 +1886,7 @@ i915_capture_gpu_state(struct drm_i915_private *i915)
 	error->i915 = i915;
 
 	stop_machine(capture, error, NULL);
+	i915_gpu_state_compress(error);
 
 	return error;
 }
@@ -33,7 +33,7 @@
 #include "i915_gem.h" /* GEM_BUG_ON() */
 #include "i915_selftest.h"
 
-#define SHIFT ilog2(KSYNCMAP)
+#define SHIFT KSYNCMAP_SHIFT
 #define MASK (KSYNCMAP - 1)
 
 /*
@@ -94,8 +94,7 @@ struct i915_syncmap {
  */
 void i915_syncmap_init(struct i915_syncmap **root)
 {
-	BUILD_BUG_ON_NOT_POWER_OF_2(KSYNCMAP);
-	BUILD_BUG_ON_NOT_POWER_OF_2(SHIFT);
+	BUILD_BUG_ON(!SHIFT);
 	BUILD_BUG_ON(KSYNCMAP > BITS_PER_BYTE * sizeof((*root)->bitmap));
 	*root = NULL;
 }
@@ -262,7 +261,7 @@ static noinline int __sync_set(struct i915_syncmap **root, u64 id, u32 seqno)
 	 * No shortcut, we have to descend the tree to find the right layer
 	 * containing this fence.
 	 *
-	 * Each layer in the tree holds 16 (KSYNCMAP) pointers, either fences
+	 * Each layer in the tree holds KSYNCMAP pointers, either fences
 	 * or lower layers. Leaf nodes (height = 0) contain the fences, all
 	 * other nodes (height > 0) are internal layers that point to a lower
 	 * node. Each internal layer has at least 2 descendents.
@@ -293,7 +292,7 @@ static noinline int __sync_set(struct i915_syncmap **root, u64 id, u32 seqno)
 
 			/* Compute the height at which these two diverge */
 			above = fls64(__sync_branch_prefix(p, id) ^ p->prefix);
-			above = round_up(above, SHIFT);
+			above = roundup(above, SHIFT);
 			next->height = above + p->height;
 			next->prefix = __sync_branch_prefix(next, id);
 
@@ -28,7 +28,17 @@
 #include <linux/types.h>
 
 struct i915_syncmap;
-#define KSYNCMAP 16 /* radix of the tree, how many slots in each layer */
+
+/*
+ * The radix of the tree, how many slots in each layer, is 1 << KSYNCMAP_SHIFT.
+ * A wider fan-out gives a shallower tree (fewer pointer chases when we miss
+ * the cached leaf) at the cost of larger, sparser layers. It is limited by
+ * the width of the per-layer bitmap.
+ */
+#ifndef KSYNCMAP_SHIFT
+#define KSYNCMAP_SHIFT 4
+#endif
+#define KSYNCMAP (1u << KSYNCMAP_SHIFT)
 
 void i915_syncmap_init(struct i915_syncmap **root);
 int i915_syncmap_set(struct i915_syncmap **root, u64 id, u32 seqno);
@@ -529,6 +529,7 @@ static ssize_t error_state_read(struct file *filp, struct kobject *kobj,
 		return ret;
 
 	gpu = i915_first_error_state(dev_priv);
+	i915_gpu_state_wait(gpu);
 	ret = i915_error_state_to_str(&error_str, gpu);
 	if (ret)
 		goto out;
@@ -650,6 +650,8 @@ int __i915_vma_do_pin(struct i915_vma *vma,
 	GEM_BUG_ON((flags & (PIN_GLOBAL | PIN_USER)) == 0);
 	GEM_BUG_ON((flags & PIN_GLOBAL) && !i915_vma_is_ggtt(vma));
 
+	vma->vm->pin_stats.slow++;
+
 	if (WARN_ON(bound & I915_VMA_PIN_OVERFLOW)) {
 		ret = -EBUSY;
 		goto err_unpin;
@@ -742,6 +744,11 @@ void i915_vma_revoke_mmap(struct i915_vma *vma)
 	GEM_BUG_ON(!i915_vma_is_map_and_fenceable(vma));
 	GEM_BUG_ON(!vma->obj->userfault_count);
 
+	/* Stop i915_gem_fault_fast() from reinstating the PTE we zap */
+	mutex_lock(&vma->obj->userfault_lock);
+	if (vma->obj->userfault_vma == vma)
+		vma->obj->userfault_vma = NULL;
+
 	vma_offset = vma->ggtt_view.partial.offset << PAGE_SHIFT;
 #ifdef __linux__
 	unmap_mapping_range(vma->vm->i915->drm.anon_inode->i_mapping,
@@ -755,6 +762,8 @@ void i915_vma_revoke_mmap(struct i915_vma *vma)
 	i915_vma_unset_userfault(vma);
 	if (!--vma->obj->userfault_count)
 		list_del(&vma->obj->userfault_link);
+
+	mutex_unlock(&vma->obj->userfault_lock);
 }
 
 int i915_vma_unbind(struct i915_vma *vma)
@@ -291,16 +291,25 @@ int __i915_vma_do_pin(struct i915_vma *vma,
 static inline int __must_check
 i915_vma_pin(struct i915_vma *vma, u64 size, u64 alignment, u64 flags)
 {
+	unsigned int bound;
+
 	BUILD_BUG_ON(PIN_MBZ != I915_VMA_PIN_OVERFLOW);
 	BUILD_BUG_ON(PIN_GLOBAL != I915_VMA_GLOBAL_BIND);
 	BUILD_BUG_ON(PIN_USER != I915_VMA_LOCAL_BIND);
 
 	/* Pin early to prevent the shrinker/eviction logic from destroying
 	 * our vma as we insert and bind.
+	 *
+	 * If the vma is already bound for every use requested (it may also
+	 * be bound for others, e.g. a GGTT vma used via the aliasing ppgtt),
+	 * the pin is all that is left to do.
 	 */
-	if (likely(((++vma->flags ^ flags) & I915_VMA_BIND_MASK) == 0)) {
+	bound = ++vma->flags;
+	if (likely(!(bound & I915_VMA_PIN_OVERFLOW) &&
+		   !(flags & ~bound & I915_VMA_BIND_MASK))) {
 		GEM_BUG_ON(!drm_mm_node_allocated(&vma->node));
 		GEM_BUG_ON(i915_vma_misplaced(vma, size, alignment, flags));
+		vma->vm->pin_stats.fast++;
 		return 0;
 	}
 
@@ -518,6 +518,27 @@ static inline int wakeup_priority(struct intel_breadcrumbs *b,
 		return tsk->prio;
 }
 
+static struct rb_node *
+__intel_breadcrumbs_wakeup_completed(struct intel_engine_cs *engine,
+				     struct rb_node *rb, int priority)
+{
+	struct intel_breadcrumbs *b = &engine->breadcrumbs;
+	u32 seqno = intel_engine_get_seqno(engine);
+
+	/* Wake up the run of completed waiters that may be chained to
+	 * @priority, and return the first waiter left (if any).
+	 */
+	while (chain_wakeup(rb, priority) &&
+	       i915_seqno_passed(seqno, to_wait(rb)->seqno)) {
+		struct rb_node *next = rb_next(rb);
+
+		__intel_breadcrumbs_finish(b, to_wait(rb));
+		rb = next;
+	}
+
+	return rb;
+}
+
 static void __intel_engine_remove_wait(struct intel_engine_cs *engine,
 				       struct intel_wait *wait)
 {
@@ -538,31 +559,23 @@ static void __intel_engine_remove_wait(struct intel_engine_cs *engine,
 		 * takes us to wake up and find the next waiter, we have to
 		 * wake up that waiter for it to perform its own coherent
 		 * completion check.
+		 *
+		 * If the following waiters are already complete, wake them
+		 * all up now in a single pass under b->rb_lock, rather than
+		 * handing the bottom-half from one completed waiter to the
+		 * next, each costing a context switch and a trip through
+		 * b->rb_lock.
+		 *
+		 * However, waking up a chain adds extra latency to the
+		 * first_waiter. This is undesirable if that waiter is a high
+		 * priority task, so we only chain waiters of the same or
+		 * higher priority and hand the bottom-half to the first lower
+		 * priority waiter, which then wakes the rest. The signaler
+		 * never chains, it must get back to signaling fences.
 		 */
-		next = rb_next(&wait->node);
-		if (chain_wakeup(next, priority)) {
-			/* If the next waiter is already complete,
-			 * wake it up and continue onto the next waiter. So
-			 * if have a small herd, they will wake up in parallel
-			 * rather than sequentially, which should reduce
-			 * the overall latency in waking all the completed
-			 * clients.
-			 *
-			 * However, waking up a chain adds extra latency to
-			 * the first_waiter. This is undesirable if that
-			 * waiter is a high priority task.
-			 */
-			u32 seqno = intel_engine_get_seqno(engine);
-
-			while (i915_seqno_passed(seqno, to_wait(next)->seqno)) {
-				struct rb_node *n = rb_next(next);
-
-				__intel_breadcrumbs_finish(b, to_wait(next));
-				next = n;
-				if (!chain_wakeup(next, priority))
-					break;
-			}
-		}
+		next = __intel_breadcrumbs_wakeup_completed(engine,
+							    rb_next(&wait->node),
+							    priority);
 
 		__intel_breadcrumbs_next(engine, next);
 	} else {
@@ -685,6 +698,11 @@ static int intel_breadcrumbs_signaler(void *arg)
 
 			i915_gem_request_put(request);
 
+			/* Retire it (and its predecessors) without waiting
+			 * for the next tick of the retire worker.
+			 */
+			i915_gem_queue_retire(engine);
+
 			/* If the engine is saturated we may be continually
 			 * processing completed requests. This angers the
 			 * NMI watchdog if we never let anything else
@@ -440,6 +440,9 @@ void intel_engine_setup_common(struct intel_engine_cs *engine)
 	intel_engine_init_timeline(engine);
 	intel_engine_init_hangcheck(engine);
 	i915_gem_batch_pool_init(engine, &engine->batch_pool);
+	init_llist_head(&engine->request_pool.free);
+	INIT_DELAYED_WORK(&engine->retire_work,
+			  i915_gem_engine_retire_work_handler);
 
 	intel_engine_init_cmd_parser(engine);
 }
@@ -677,8 +680,10 @@ void intel_engine_cleanup_common(struct intel_engine_cs *engine)
 		cleanup_status_page(engine);
 
 	intel_engine_fini_breadcrumbs(engine);
+	cancel_delayed_work_sync(&engine->retire_work);
 	intel_engine_cleanup_cmd_parser(engine);
 	i915_gem_batch_pool_fini(&engine->batch_pool);
+	i915_gem_request_pool_trim(engine);
 
 	if (engine->default_state)
 		i915_gem_object_put(engine->default_state);
@@ -1617,6 +1622,7 @@ void intel_engines_park(struct drm_i915_private *i915)
 			engine->park(engine);
 
 		i915_gem_batch_pool_fini(&engine->batch_pool);
+		i915_gem_request_pool_trim(engine);
 		engine->execlists.no_priolist = false;
 	}
 }
@@ -1746,6 +1752,10 @@ void intel_engine_dump(struct intel_engine_cs *engine,
 	drm_printf(m, "\tReset count: %d (global %d)\n",
 		   i915_reset_engine_count(error, engine),
 		   i915_reset_count(error));
+	drm_printf(m, "\tWait spin: avg %lu ns, %d hits, %d misses\n",
+		   READ_ONCE(engine->spin.avg_ns),
+		   atomic_read(&engine->spin.hits),
+		   atomic_read(&engine->spin.misses));
 
 	rcu_read_lock();
 
@@ -368,6 +368,20 @@ struct intel_engine_cs {
 		struct i915_pmu_sample sample[I915_ENGINE_SAMPLE_MAX];
 	} pmu;
 
+	/*
+	 * Adaptive busywait for i915_wait_request(). We keep a running
+	 * average of how long a request takes to complete once it has
+	 * started executing, and only spin before enabling the interrupt
+	 * if that is short enough to make spinning worthwhile. The hit and
+	 * miss counts are reported by intel_engine_dump().
+	 */
+	struct {
+		unsigned long avg_ns; /* updated locklessly, approximate */
+		unsigned int skipped; /* likewise, only used to pace probes */
+		atomic_t hits;
+		atomic_t misses;
+	} spin;
+
 	/*
 	 * A pool of objects to use as shadow copies of client batch buffers
 	 * when the command parser is enabled. Prevents the client from
@@ -375,6 +389,24 @@ struct intel_engine_cs {
 	 */
 	struct i915_gem_batch_pool batch_pool;
 
+	/*
+	 * A small stash of released requests, reused by the next
+	 * i915_gem_request_alloc() on this engine before falling back to
+	 * the slab cache. Released requests may be pushed from any context,
+	 * but are only ever popped under struct_mutex.
+	 */
+	struct {
+		struct llist_head free;
+		atomic_t count;
+	} request_pool;
+
+	/*
+	 * Retire this engine's requests as soon as they are signaled, rather
+	 * than waiting for the periodic gt.retire_work, so that their buffers
+	 * become idle (and reusable from the batch pool) promptly.
+	 */
+	struct delayed_work retire_work;
+
 	struct intel_hw_status_page status_page;
 	struct i915_ctx_workarounds wa_ctx;
 	struct i915_vma *scratch;
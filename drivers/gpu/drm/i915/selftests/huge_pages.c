@@ -583,6 +583,69 @@ out_put:
 	return err;
 }
 
+static int igt_mock_ppgtt_huge_tail(void *arg)
+{
+	struct i915_hw_ppgtt *ppgtt = arg;
+	struct drm_i915_private *i915 = ppgtt->base.i915;
+	const unsigned int expected_gtt =
+		I915_GTT_PAGE_SIZE_2M | I915_GTT_PAGE_SIZE_4K;
+	struct drm_i915_gem_object *obj;
+	struct i915_vma *vma;
+	int err;
+
+	/*
+	 * A single 2M aligned sg chunk of 3M must be mapped as one 2M page
+	 * followed by 4K pages for the remaining 1M, and never as two 2M
+	 * pages, which would map 1M past the end of the chunk.
+	 */
+
+	if (!HAS_PAGE_SIZES(i915, I915_GTT_PAGE_SIZE_2M))
+		return 0;
+
+	obj = fake_huge_pages_object(i915, SZ_2M + SZ_1M, true);
+	if (IS_ERR(obj))
+		return PTR_ERR(obj);
+
+	err = i915_gem_object_pin_pages(obj);
+	if (err)
+		goto out_put;
+
+	/* fake_get_huge_pages_single() places the chunk at a 2M dma address */
+	GEM_BUG_ON(!IS_ALIGNED(sg_dma_address(obj->mm.pages->sgl),
+			       I915_GTT_PAGE_SIZE_2M));
+
+	/* Force the page sizes for this object */
+	obj->mm.page_sizes.sg = expected_gtt;
+
+	vma = i915_vma_instance(obj, &ppgtt->base, NULL);
+	if (IS_ERR(vma)) {
+		err = PTR_ERR(vma);
+		goto out_unpin;
+	}
+
+	err = i915_vma_pin(vma, 0, 0, PIN_USER);
+	if (err)
+		goto out_close;
+
+	err = igt_check_page_sizes(vma);
+
+	if (vma->page_sizes.gtt != expected_gtt) {
+		pr_err("page_sizes.gtt=%u, expected %u\n",
+		       vma->page_sizes.gtt, expected_gtt);
+		err = -EINVAL;
+	}
+
+	i915_vma_unpin(vma);
+out_close:
+	i915_vma_close(vma);
+out_unpin:
+	i915_gem_object_unpin_pages(obj);
+out_put:
+	i915_gem_object_put(obj);
+
+	return err;
+}
+
 static void close_object_list(struct list_head *objects,
 			      struct i915_hw_ppgtt *ppgtt)
 {
@@ -1336,6 +1399,90 @@ out_put:
 	return err;
 }
 
+static int igt_ppgtt_bind_throughput(void *arg)
+{
+	struct i915_gem_context *ctx = arg;
+	struct drm_i915_private *i915 = ctx->i915;
+	unsigned int saved_mask = INTEL_INFO(i915)->page_sizes;
+	static const unsigned int masks[] = {
+		I915_GTT_PAGE_SIZE_4K,
+		I915_GTT_PAGE_SIZE_64K | I915_GTT_PAGE_SIZE_4K,
+		I915_GTT_PAGE_SIZE_2M | I915_GTT_PAGE_SIZE_64K | I915_GTT_PAGE_SIZE_4K,
+	};
+	struct i915_address_space *vm;
+	struct drm_i915_gem_object *obj;
+	struct i915_vma *vma;
+	int i, err = 0;
+
+	/*
+	 * Measure how quickly we can write the PTEs for a 1GiB object, backed
+	 * by fake dma addresses, using each of the page sizes the device
+	 * supports. We only time insert_entries() itself, the page
+	 * directories having been allocated by the first bind.
+	 */
+
+	if (!ctx->ppgtt) {
+		pr_info("full-ppgtt not supported, skipping\n");
+		return 0;
+	}
+	vm = &ctx->ppgtt->base;
+
+	for (i = 0; i < ARRAY_SIZE(masks); i++) {
+		unsigned long count;
+		ktime_t dt;
+
+		if ((masks[i] & saved_mask) != masks[i])
+			continue;
+
+		mkwrite_device_info(i915)->page_sizes = masks[i];
+
+		obj = fake_huge_pages_object(i915, SZ_1G, false);
+		if (IS_ERR(obj)) {
+			err = PTR_ERR(obj);
+			goto out_device;
+		}
+
+		vma = i915_vma_instance(obj, vm, NULL);
+		if (IS_ERR(vma)) {
+			err = PTR_ERR(vma);
+			goto out_put;
+		}
+
+		err = i915_vma_pin(vma, 0, SZ_2M, PIN_USER);
+		if (err)
+			goto out_close;
+
+		count = 0;
+		dt = ktime_get();
+		do {
+			vm->insert_entries(vm, vma, obj->cache_level, 0);
+			count++;
+		} while (ktime_to_ns(ktime_sub(ktime_get(), dt)) < NSEC_PER_SEC / 10);
+		dt = ktime_sub(ktime_get(), dt);
+
+		pr_info("%s: page-sizes %x (gtt %x): bound 1GiB %lu times in %lluus, %llu MiB/s\n",
+			__func__, masks[i], vma->page_sizes.gtt, count,
+			div_u64(ktime_to_ns(dt), NSEC_PER_USEC),
+			div64_u64((u64)count * SZ_1K * NSEC_PER_SEC,
+				  ktime_to_ns(dt)));
+
+		i915_vma_unpin(vma);
+		i915_vma_close(vma);
+		i915_gem_object_put(obj);
+	}
+
+	goto out_device;
+
+out_close:
+	i915_vma_close(vma);
+out_put:
+	i915_gem_object_put(obj);
+out_device:
+	mkwrite_device_info(i915)->page_sizes = saved_mask;
+
+	return err;
+}
+
 static inline bool igt_can_allocate_thp(struct drm_i915_private *i915)
 {
 	return i915->mm.gemfs && has_transparent_hugepage();
@@ -1670,6 +1817,7 @@ int i915_gem_huge_page_mock_selftests(void)
 	static const struct i915_subtest tests[] = {
 		SUBTEST(igt_mock_exhaust_device_supported_pages),
 		SUBTEST(igt_mock_ppgtt_misaligned_dma),
+		SUBTEST(igt_mock_ppgtt_huge_tail),
 		SUBTEST(igt_mock_ppgtt_huge_fill),
 		SUBTEST(igt_mock_ppgtt_64K),
 	};
@@ -1734,6 +1882,7 @@ int i915_gem_huge_page_live_selftests(struct drm_i915_private *dev_priv)
 		SUBTEST(igt_ppgtt_exhaust_huge),
 		SUBTEST(igt_ppgtt_gemfs_huge),
 		SUBTEST(igt_ppgtt_internal_huge),
+		SUBTEST(igt_ppgtt_bind_throughput),
 	};
 	struct drm_file *file;
 	struct i915_gem_context *ctx;
@@ -581,3 +581,267 @@ int i915_gem_context_live_selftests(struct drm_i915_private *dev_priv)
 
 	return err;
 }
+
+/*
+ * The handle table only stores the vma pointer, it never follows it, so we
+ * can fill it with fake pointers derived from the handle and check every
+ * lookup against a plain bitmap of which handles should be present.
+ */
+static struct i915_vma *fake_vma(u32 handle)
+{
+	return u64_to_ptr(struct i915_vma, (u64)handle << 4 | 8);
+}
+
+static int check_handle_table(const struct i915_handle_table *t,
+			      const u32 *handles,
+			      const unsigned long *present,
+			      unsigned int count)
+{
+	unsigned int n, expected = 0;
+
+	for (n = 0; n < count; n++) {
+		struct i915_vma *vma = i915_handle_table_lookup(t, handles[n]);
+		struct i915_vma *want =
+			test_bit(n, present) ? fake_vma(handles[n]) : NULL;
+
+		if (vma != want) {
+			pr_err("Lookup of handle %x returned %p, expected %p\n",
+			       handles[n], vma, want);
+			return -EINVAL;
+		}
+
+		expected += !!want;
+	}
+
+	if (t->count != expected) {
+		pr_err("Table holds %u handles, expected %u\n",
+		       t->count, expected);
+		return -EINVAL;
+	}
+
+	if (t->slots && 2 * t->count > BIT(t->bits)) {
+		pr_err("Table is more than half full: %u of %lu slots\n",
+		       t->count, BIT(t->bits));
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int handle_table_toggle(struct i915_handle_table *t,
+			       const u32 *handles,
+			       unsigned long *present,
+			       unsigned int n)
+{
+	struct i915_vma *vma;
+	int err;
+
+	if (test_bit(n, present)) {
+		vma = i915_handle_table_remove(t, handles[n]);
+		if (vma != fake_vma(handles[n])) {
+			pr_err("Removing handle %x returned %p, expected %p\n",
+			       handles[n], vma, fake_vma(handles[n]));
+			return -EINVAL;
+		}
+
+		vma = i915_handle_table_remove(t, handles[n]);
+		if (vma) {
+			pr_err("Removed handle %x twice\n", handles[n]);
+			return -EINVAL;
+		}
+
+		__clear_bit(n, present);
+	} else {
+		err = i915_handle_table_insert(t, handles[n],
+					       fake_vma(handles[n]));
+		if (err) {
+			pr_err("Inserting handle %x failed, err=%d\n",
+			       handles[n], err);
+			return err;
+		}
+
+		err = i915_handle_table_insert(t, handles[n],
+					       fake_vma(handles[n]));
+		if (err != -EEXIST) {
+			pr_err("Inserted handle %x twice, err=%d\n",
+			       handles[n], err);
+			return -EINVAL;
+		}
+
+		__set_bit(n, present);
+	}
+
+	return 0;
+}
+
+static int igt_handle_table_random(void *arg)
+{
+	const unsigned int count = 4096;
+	I915_RND_STATE(prng);
+	IGT_TIMEOUT(end_time);
+	struct i915_handle_table t;
+	unsigned long *present;
+	unsigned int bits, n;
+	unsigned long pass;
+	u32 *handles;
+	u32 key;
+	int err = -ENOMEM;
+
+	/*
+	 * Insert and remove random handles, checking every lookup against
+	 * the reference after each resize and periodically in between.
+	 */
+
+	handles = kmalloc_array(count, sizeof(*handles), GFP_KERNEL);
+	present = kcalloc(BITS_TO_LONGS(count), sizeof(*present), GFP_KERNEL);
+	if (!handles || !present)
+		goto out_free;
+
+	/* xor with a random key keeps the handles distinct but scattered */
+	key = prandom_u32_state(&prng);
+	for (n = 0; n < count; n++)
+		handles[n] = n ^ key;
+
+	i915_handle_table_init(&t);
+
+	bits = 0;
+	pass = 0;
+	do {
+		n = i915_prandom_u32_max_state(count, &prng);
+		err = handle_table_toggle(&t, handles, present, n);
+		if (err)
+			goto out;
+
+		if (t.bits != bits || pass % 64 == 0) {
+			err = check_handle_table(&t, handles, present, count);
+			if (err)
+				goto out;
+
+			bits = t.bits;
+		}
+		pass++;
+	} while (!__igt_timeout(end_time, NULL));
+
+	/* And finally empty the table */
+	for (n = 0; n < count; n++) {
+		if (test_bit(n, present)) {
+			err = handle_table_toggle(&t, handles, present, n);
+			if (err)
+				goto out;
+		}
+	}
+
+	err = check_handle_table(&t, handles, present, count);
+	pr_debug("%s: Completed %lu operations, table grew to %lu slots\n",
+		 __func__, pass, BIT(bits));
+out:
+	kvfree(t.slots);
+out_free:
+	kfree(present);
+	kfree(handles);
+	return err;
+}
+
+static int igt_handle_table_collide(void *arg)
+{
+	const unsigned int bits = I915_HANDLE_TABLE_MIN_BITS;
+	const unsigned int mask = BIT(bits) - 1;
+	const unsigned int home[] = { mask - 1, mask, 0, 1 };
+	u32 handles[ARRAY_SIZE(home) * 6];
+	unsigned long present[BITS_TO_LONGS(ARRAY_SIZE(handles))];
+	const unsigned int count = ARRAY_SIZE(handles);
+	const unsigned int per_home = count / ARRAY_SIZE(home);
+	I915_RND_STATE(prng);
+	struct i915_handle_table t;
+	unsigned int *order;
+	unsigned int i, n;
+	u32 h;
+	int err = 0;
+
+	/*
+	 * Build runs of handles sharing the last and first few slots of
+	 * the smallest table, so that probing and the backward shift on
+	 * removal wrap around the end of the table, and then remove each
+	 * handle from the full table in turn.
+	 */
+
+	BUILD_BUG_ON(2 * ARRAY_SIZE(handles) > BIT(I915_HANDLE_TABLE_MIN_BITS));
+
+	n = 0;
+	for (i = 0; i < ARRAY_SIZE(home); i++) {
+		unsigned int found = 0;
+
+		for (h = 0; found < per_home; h++) {
+			if (hash_32(h, bits) != home[i])
+				continue;
+
+			handles[n++] = h;
+			found++;
+		}
+	}
+	GEM_BUG_ON(n != count);
+
+	order = i915_random_order(count, &prng);
+	if (!order)
+		return -ENOMEM;
+
+	i915_handle_table_init(&t);
+	memset(present, 0, sizeof(present));
+
+	for (n = 0; n < count; n++) {
+		err = handle_table_toggle(&t, handles, present, order[n]);
+		if (err)
+			goto out;
+	}
+
+	if (t.bits != bits) {
+		pr_err("Table grew to %u bits for only %u handles\n",
+		       t.bits, count);
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = check_handle_table(&t, handles, present, count);
+	if (err)
+		goto out;
+
+	for (n = 0; n < count; n++) {
+		/* Remove one handle, check the others, then put it back */
+		for (i = 0; i < 2; i++) {
+			err = handle_table_toggle(&t, handles, present, n);
+			if (err)
+				goto out;
+
+			err = check_handle_table(&t, handles, present, count);
+			if (err)
+				goto out;
+		}
+	}
+
+	/* Empty the table in another random order, checking as we go */
+	i915_random_reorder(order, count, &prng);
+	for (n = 0; n < count; n++) {
+		err = handle_table_toggle(&t, handles, present, order[n]);
+		if (err)
+			goto out;
+
+		err = check_handle_table(&t, handles, present, count);
+		if (err)
+			goto out;
+	}
+
+out:
+	kvfree(t.slots);
+	kfree(order);
+	return err;
+}
+
+int i915_gem_context_mock_selftests(void)
+{
+	static const struct i915_subtest tests[] = {
+		SUBTEST(igt_handle_table_collide),
+		SUBTEST(igt_handle_table_random),
+	};
+
+	return i915_subtests(tests, NULL);
+}
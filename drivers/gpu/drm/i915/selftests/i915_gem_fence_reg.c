@@ -0,0 +1,359 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include "../i915_selftest.h"
+
+#include "i915_random.h"
+#include "mock_gem_device.h"
+
+/*
+ * The mock device has no fence registers to write, so we replay the fault
+ * traces against the fence bookkeeping alone: fence_find() picks the victim
+ * exactly as it would for i915_vma_pin_fence(), and mock_fault() then does
+ * what fence_update() would do to the lists.
+ */
+
+struct mock_trace {
+	struct drm_i915_private *i915;
+	struct i915_vma **vma;
+	unsigned int count;
+};
+
+static void mock_fences(struct drm_i915_private *i915, unsigned int count)
+{
+	unsigned int i;
+
+	GEM_BUG_ON(count > I915_MAX_NUM_FENCES);
+
+	INIT_LIST_HEAD(&i915->mm.fence_list);
+	memset(&i915->mm.fence_stats, 0, sizeof(i915->mm.fence_stats));
+
+	i915->num_fence_regs = count;
+	for (i = 0; i < count; i++) {
+		struct drm_i915_fence_reg *fence = &i915->fence_regs[i];
+
+		memset(fence, 0, sizeof(*fence));
+		fence->i915 = i915;
+		fence->id = i;
+		list_add_tail(&fence->link, &i915->mm.fence_list);
+	}
+}
+
+static int mock_trace_init(struct mock_trace *t,
+			   struct drm_i915_private *i915,
+			   unsigned int count)
+{
+	unsigned int n;
+
+	t->i915 = i915;
+	t->count = 0;
+
+	t->vma = kcalloc(count, sizeof(*t->vma), GFP_KERNEL);
+	if (!t->vma)
+		return -ENOMEM;
+
+	for (n = 0; n < count; n++) {
+		struct drm_i915_gem_object *obj;
+		struct i915_vma *vma;
+
+		obj = i915_gem_object_create_internal(i915, PAGE_SIZE);
+		if (IS_ERR(obj))
+			return PTR_ERR(obj);
+
+		vma = i915_vma_instance(obj, &i915->ggtt.base, NULL);
+		if (IS_ERR(vma)) {
+			i915_gem_object_put(obj);
+			return PTR_ERR(vma);
+		}
+
+		vma->flags |= I915_VMA_CAN_FENCE;
+		t->vma[t->count++] = vma;
+	}
+
+	return 0;
+}
+
+static void mock_trace_fini(struct mock_trace *t)
+{
+	unsigned int n;
+
+	for (n = 0; n < t->count; n++) {
+		struct i915_vma *vma = t->vma[n];
+
+		if (vma->fence) {
+			vma->fence->vma = NULL;
+			vma->fence = NULL;
+		}
+		i915_vma_unset_userfault(vma);
+
+		i915_gem_object_put(vma->obj);
+	}
+	kfree(t->vma);
+
+	t->i915->num_fence_regs = 0;
+	INIT_LIST_HEAD(&t->i915->mm.fence_list);
+}
+
+static int mock_fault(struct i915_vma *vma, bool user)
+{
+	struct drm_i915_private *i915 = vma->vm->i915;
+	struct drm_i915_fence_reg *fence = vma->fence;
+
+	if (fence) {
+		i915->mm.fence_stats.hits++;
+	} else {
+		i915->mm.fence_stats.misses++;
+
+		fence = fence_find(i915);
+		if (IS_ERR(fence))
+			return PTR_ERR(fence);
+
+		if (fence->vma) {
+			fence_steal(fence);
+
+			i915_vma_unset_userfault(fence->vma);
+			fence->vma->fence = NULL;
+		}
+
+		fence->vma = vma;
+		vma->fence = fence;
+	}
+
+	if (user)
+		i915_vma_set_userfault(vma);
+
+	list_move_tail(&fence->link, &i915->mm.fence_list);
+	return 0;
+}
+
+static int igt_fence_protect_mmap(void *arg)
+{
+	struct drm_i915_private *i915 = arg;
+	const unsigned int nfences = 16, nuser = 8, ngpu = 32;
+	struct i915_fence_stats *stats = &i915->mm.fence_stats;
+	struct mock_trace t;
+	unsigned int pass, i, j, gpu;
+	int err;
+
+	/*
+	 * Interleave faults on a few GTT mmaps with a larger set of fenced
+	 * objects used only by the GPU. A plain LRU would cycle every fence
+	 * through the GPU objects, stealing each mmap's fence in turn and
+	 * forcing userspace to refault. We expect the mmaps to keep theirs.
+	 */
+
+	mock_fences(i915, nfences);
+
+	err = mock_trace_init(&t, i915, nuser + ngpu);
+	if (err)
+		goto out;
+
+	gpu = 0;
+	for (pass = 0; pass < 64; pass++) {
+		for (i = 0; i < nuser; i++) {
+			err = mock_fault(t.vma[i], true);
+			if (err)
+				goto out;
+
+			for (j = 0; j < 4; j++) {
+				err = mock_fault(t.vma[nuser + gpu++ % ngpu],
+						 false);
+				if (err)
+					goto out;
+			}
+		}
+	}
+
+	if (!stats->steals) {
+		pr_err("Expected the GPU objects to contend for fences\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (stats->revokes) {
+		pr_err("Stole %lu fences from GTT mmaps while idle fences were available\n",
+		       stats->revokes);
+		err = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < nuser; i++) {
+		if (!t.vma[i]->fence || t.vma[i]->obj->fence_steals) {
+			pr_err("GTT mmap %d lost its fence\n", i);
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+out:
+	mock_trace_fini(&t);
+	return err;
+}
+
+static int igt_fence_steal_history(void *arg)
+{
+	struct drm_i915_private *i915 = arg;
+	const unsigned int nfences = 2, count = 64;
+	struct i915_fence_stats *stats = &i915->mm.fence_stats;
+	struct i915_vma *a, *b, *c;
+	struct mock_trace t;
+	unsigned int n;
+	int err;
+
+	/*
+	 * An mmap that has already lost its fence should keep it in favour
+	 * of one that has not, even if that one was used more recently. Once
+	 * enough other fences have been stolen since, that history is
+	 * forgotten and the mmap is again chosen by LRU.
+	 */
+
+	mock_fences(i915, nfences);
+
+	err = mock_trace_init(&t, i915, count);
+	if (err)
+		goto out;
+
+	a = t.vma[0];
+	b = t.vma[1];
+	c = t.vma[2];
+
+	/* Steal a's fence once, fault it back in, and then touch c */
+	err = mock_fault(a, true);
+	if (!err)
+		err = mock_fault(b, true);
+	if (!err)
+		err = mock_fault(c, true);
+	if (!err)
+		err = mock_fault(a, true);
+	if (!err)
+		err = mock_fault(c, true);
+	if (err)
+		goto out;
+
+	if (!a->fence || !c->fence) {
+		pr_err("Expected a and c to hold the fences\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* a is now the least recently used, but the most expensive */
+	for (n = 3; n < count; n++) {
+		err = mock_fault(t.vma[n], true);
+		if (err)
+			goto out;
+
+		if (!a->fence)
+			break;
+	}
+
+	if (a->fence) {
+		pr_err("Fence history never aged, a kept its fence through %lu steals\n",
+		       stats->steals);
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (n == 3) {
+		pr_err("Stole the fence of a, ignoring its history\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+out:
+	mock_trace_fini(&t);
+	return err;
+}
+
+static int igt_fence_pinned(void *arg)
+{
+	struct drm_i915_private *i915 = arg;
+	const unsigned int nfences = 8;
+	struct drm_i915_fence_reg *fence;
+	struct mock_trace t;
+	unsigned int n;
+	int err;
+
+	/* Pinned fences must never be chosen, no matter how cheap */
+
+	mock_fences(i915, nfences);
+
+	err = mock_trace_init(&t, i915, nfences);
+	if (err)
+		goto out;
+
+	for (n = 0; n < nfences; n++) {
+		err = mock_fault(t.vma[n], n & 1);
+		if (err)
+			goto out;
+
+		t.vma[n]->fence->pin_count++;
+	}
+
+	fence = fence_find(i915);
+	if (!IS_ERR(fence) || PTR_ERR(fence) != -EDEADLK) {
+		pr_err("fence_find() returned %p with every fence pinned\n",
+		       fence);
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* Release the most expensive, a GTT mmap, which must then be used */
+	t.vma[1]->fence->pin_count--;
+	fence = fence_find(i915);
+	if (fence != t.vma[1]->fence) {
+		pr_err("fence_find() did not return the only unpinned fence\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	for (n = 0; n < nfences; n++)
+		if (t.vma[n]->fence->pin_count)
+			t.vma[n]->fence->pin_count--;
+
+out:
+	mock_trace_fini(&t);
+	return err;
+}
+
+int i915_gem_fence_reg_mock_selftests(void)
+{
+	static const struct i915_subtest tests[] = {
+		SUBTEST(igt_fence_protect_mmap),
+		SUBTEST(igt_fence_steal_history),
+		SUBTEST(igt_fence_pinned),
+	};
+	struct drm_i915_private *i915;
+	int err;
+
+	i915 = mock_gem_device();
+	if (!i915)
+		return -ENOMEM;
+
+	mutex_lock(&i915->drm.struct_mutex);
+	err = i915_subtests(tests, i915);
+	mutex_unlock(&i915->drm.struct_mutex);
+
+	drm_dev_unref(&i915->drm);
+	return err;
+}
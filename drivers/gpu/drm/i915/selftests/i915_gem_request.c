@@ -246,6 +246,62 @@ err_context_0:
 	return err;
 }
 
+static unsigned long __igt_request_rate(struct drm_i915_private *i915,
+					bool use_pool, int *err)
+{
+	struct intel_engine_cs *engine = i915->engine[RCS];
+	unsigned long count;
+	ktime_t dt;
+
+	count = 0;
+	dt = ktime_get();
+	do {
+		struct drm_i915_gem_request *request;
+
+		if (!use_pool)
+			i915_gem_request_pool_trim(engine);
+
+		request = mock_request(engine, i915->kernel_context, 0);
+		if (!request) {
+			*err = -ENOMEM;
+			break;
+		}
+
+		i915_add_request(request);
+		count++;
+	} while (ktime_to_ns(ktime_sub(ktime_get(), dt)) < NSEC_PER_SEC / 10);
+	dt = ktime_sub(ktime_get(), dt);
+
+	mock_device_flush(i915);
+	return div64_u64(count * NSEC_PER_SEC, ktime_to_ns(dt));
+}
+
+static int igt_request_rate(void *arg)
+{
+	struct drm_i915_private *i915 = arg;
+	unsigned long slab, pool = 0;
+	int err = 0;
+
+	/*
+	 * Measure how many requests we can construct and retire per second
+	 * on a mock engine, where there is no HW cost to hide behind, first
+	 * allocating each from the slab and then recycling them through the
+	 * engine's request pool.
+	 */
+
+	mutex_lock(&i915->drm.struct_mutex);
+	slab = __igt_request_rate(i915, false, &err);
+	if (!err)
+		pool = __igt_request_rate(i915, true, &err);
+	mutex_unlock(&i915->drm.struct_mutex);
+	if (err)
+		return err;
+
+	pr_info("%s: %lu requests/s from the slab, %lu requests/s recycled\n",
+		__func__, slab, pool);
+	return 0;
+}
+
 int i915_gem_request_mock_selftests(void)
 {
 	static const struct i915_subtest tests[] = {
@@ -253,6 +309,7 @@ int i915_gem_request_mock_selftests(void)
 		SUBTEST(igt_wait_request),
 		SUBTEST(igt_fence_wait),
 		SUBTEST(igt_request_rewind),
+		SUBTEST(igt_request_rate),
 	};
 	struct drm_i915_private *i915;
 	int err;
@@ -22,6 +22,9 @@
  *
  */
 
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
 #include "../i915_selftest.h"
 #include "i915_random.h"
 
@@ -342,7 +345,7 @@ static int igt_syncmap_join_below(void *arg)
 	 * a join.
 	 */
 	for (step = 0; step < KSYNCMAP; step++) {
-		for (order = 64 - SHIFT; order > 0; order -= SHIFT) {
+		for (order = rounddown(63, SHIFT); order > 0; order -= SHIFT) {
 			u64 context = step * BIT_ULL(order);
 
 			err = i915_syncmap_set(&sync, context, 0);
@@ -459,7 +462,7 @@ static int igt_syncmap_compact(void *arg)
 	 * height, we form a join but each child of that join is directly a
 	 * leaf holding the single id.
 	 */
-	for (order = SHIFT; order < 64; order += SHIFT) {
+	for (order = SHIFT; order <= 64 - SHIFT; order += SHIFT) {
 		err = check_syncmap_free(&sync);
 		if (err)
 			goto out;
@@ -600,6 +603,82 @@ out:
 	return dump_syncmap(sync, err);
 }
 
+static int igt_syncmap_throughput(void *arg)
+{
+	const unsigned int num_engines = 5;
+	const unsigned int num_contexts = 1024;
+	I915_RND_STATE(prng);
+	struct i915_syncmap *sync;
+	unsigned long count, lookups;
+	ktime_t dt;
+	u64 *ids;
+	u32 seqno;
+	int err = 0;
+
+	/*
+	 * Measure the lookup rate over the fence context ids we expect to
+	 * see in practice: each GEM context allocates a consecutive block of
+	 * ids, one for each engine, interleaved with the odd id handed out
+	 * to other fence producers. Most dependencies are between requests
+	 * of the same client on neighbouring engines, with the occasional
+	 * dependency upon a random other client.
+	 */
+
+	ids = kmalloc_array(num_contexts, sizeof(*ids), GFP_KERNEL);
+	if (!ids)
+		return -ENOMEM;
+
+	ids[0] = 0x1000;
+	for (count = 1; count < num_contexts; count++)
+		ids[count] = ids[count - 1] + num_engines +
+			     (prandom_u32_state(&prng) % 8 == 0);
+
+	i915_syncmap_init(&sync);
+	for (count = 0; count < num_contexts; count++) {
+		unsigned int engine;
+
+		for (engine = 0; engine < num_engines; engine++) {
+			err = i915_syncmap_set(&sync, ids[count] + engine, 1);
+			if (err)
+				goto out;
+		}
+	}
+
+	seqno = 1;
+	count = 0;
+	lookups = 0;
+	dt = ktime_get();
+	do {
+		u64 id = ids[count % num_contexts];
+		unsigned int n;
+
+		if (prandom_u32_state(&prng) % 16 == 0)
+			id = ids[prandom_u32_state(&prng) % num_contexts];
+
+		for (n = 0; n < 64; n++) {
+			u64 context = id + n % num_engines;
+
+			if (!i915_syncmap_is_later(&sync, context, seqno)) {
+				err = i915_syncmap_set(&sync, context, seqno);
+				if (err)
+					goto out;
+			}
+		}
+
+		lookups += n;
+		count++;
+	} while (ktime_to_ns(ktime_sub(ktime_get(), dt)) < NSEC_PER_SEC / 10);
+	lookups = div64_u64(lookups * NSEC_PER_SEC,
+			    ktime_to_ns(ktime_sub(ktime_get(), dt)));
+
+	pr_info("%s: fan-out %d, %lu lookups/s\n",
+		__func__, KSYNCMAP, lookups);
+
+out:
+	kfree(ids);
+	return dump_syncmap(sync, err);
+}
+
 int i915_syncmap_mock_selftests(void)
 {
 	static const struct i915_subtest tests[] = {
@@ -610,6 +689,7 @@ int i915_syncmap_mock_selftests(void)
 		SUBTEST(igt_syncmap_neighbours),
 		SUBTEST(igt_syncmap_compact),
 		SUBTEST(igt_syncmap_random),
+		SUBTEST(igt_syncmap_throughput),
 	};
 
 	return i915_subtests(tests, NULL);
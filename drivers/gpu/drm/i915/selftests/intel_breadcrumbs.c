@@ -347,6 +347,58 @@ static void igt_wake_all_sync(atomic_t *ready,
 	atomic_set(done, count);
 }
 
+static int igt_wakeup_spawn(struct igt_wakeup *waiters, int count,
+			    struct intel_engine_cs *engine,
+			    wait_queue_head_t *wq,
+			    atomic_t *ready, atomic_t *set, atomic_t *done)
+{
+	int n;
+
+	atomic_set(ready, count);
+	for (n = 0; n < count; n++) {
+		waiters[n].wq = wq;
+		waiters[n].ready = ready;
+		waiters[n].set = set;
+		waiters[n].done = done;
+		waiters[n].engine = engine;
+		waiters[n].flags = BIT(IDLE);
+
+		waiters[n].tsk = kthread_run(igt_wakeup_thread, &waiters[n],
+					     "i915/igt:%d", n);
+		if (IS_ERR(waiters[n].tsk))
+			return PTR_ERR(waiters[n].tsk);
+
+		get_task_struct(waiters[n].tsk);
+	}
+
+	return 0;
+}
+
+static void igt_wakeup_stop(struct igt_wakeup *waiters, int count,
+			    struct intel_engine_cs *engine,
+			    wait_queue_head_t *wq,
+			    atomic_t *ready, atomic_t *set, atomic_t *done)
+{
+	int n;
+
+	for (n = 0; n < count; n++) {
+		if (IS_ERR(waiters[n].tsk))
+			break;
+
+		set_bit(STOP, &waiters[n].flags);
+	}
+	mock_seqno_advance(engine, INT_MAX); /* wakeup any broken waiters */
+	igt_wake_all_sync(ready, set, done, wq, n);
+
+	for (n = 0; n < count; n++) {
+		if (IS_ERR(waiters[n].tsk))
+			break;
+
+		kthread_stop(waiters[n].tsk);
+		put_task_struct(waiters[n].tsk);
+	}
+}
+
 static int igt_wakeup(void *arg)
 {
 	I915_RND_STATE(prng);
@@ -369,22 +421,10 @@ static int igt_wakeup(void *arg)
 	/* Create a large number of threads, each waiting on a random seqno.
 	 * Multiple waiters will be waiting for the same seqno.
 	 */
-	atomic_set(&ready, count);
-	for (n = 0; n < count; n++) {
-		waiters[n].wq = &wq;
-		waiters[n].ready = &ready;
-		waiters[n].set = &set;
-		waiters[n].done = &done;
-		waiters[n].engine = engine;
-		waiters[n].flags = BIT(IDLE);
-
-		waiters[n].tsk = kthread_run(igt_wakeup_thread, &waiters[n],
-					     "i915/igt:%d", n);
-		if (IS_ERR(waiters[n].tsk))
-			goto out_waiters;
-
-		get_task_struct(waiters[n].tsk);
-	}
+	err = igt_wakeup_spawn(waiters, count, engine,
+			       &wq, &ready, &set, &done);
+	if (err)
+		goto out_waiters;
 
 	for (step = 1; step <= max_seqno; step <<= 1) {
 		u32 seqno;
@@ -431,23 +471,63 @@ static int igt_wakeup(void *arg)
 	}
 
 out_waiters:
-	for (n = 0; n < count; n++) {
-		if (IS_ERR(waiters[n].tsk))
-			break;
+	igt_wakeup_stop(waiters, count, engine, &wq, &ready, &set, &done);
+	kvfree(waiters);
+out_engines:
+	mock_engine_flush(engine);
+	return err;
+}
 
-		set_bit(STOP, &waiters[n].flags);
-	}
-	mock_seqno_advance(engine, INT_MAX); /* wakeup any broken waiters */
-	igt_wake_all_sync(&ready, &set, &done, &wq, n);
+static int igt_wakeup_latency(void *arg)
+{
+	const int state = TASK_UNINTERRUPTIBLE;
+	struct intel_engine_cs *engine = arg;
+	struct igt_wakeup *waiters;
+	DECLARE_WAIT_QUEUE_HEAD_ONSTACK(wq);
+	const int count = 1000;
+	atomic_t ready, set, done;
+	ktime_t dt;
+	int err = -ENOMEM;
+	int n;
 
-	for (n = 0; n < count; n++) {
-		if (IS_ERR(waiters[n].tsk))
-			break;
+	mock_engine_reset(engine);
 
-		kthread_stop(waiters[n].tsk);
-		put_task_struct(waiters[n].tsk);
+	waiters = kvmalloc_array(count, sizeof(*waiters), GFP_KERNEL);
+	if (!waiters)
+		goto out_engines;
+
+	err = igt_wakeup_spawn(waiters, count, engine,
+			       &wq, &ready, &set, &done);
+	if (err)
+		goto out_waiters;
+
+	/* Put the whole herd to sleep on a single breadcrumb, so that one
+	 * seqno update completes every waiter at once, and measure how long
+	 * it takes for the last of them to be woken and leave the tree.
+	 */
+	for (n = 0; n < count; n++)
+		waiters[n].seqno = 1;
+	mock_seqno_advance(engine, 0);
+	igt_wake_all_sync(&ready, &set, &done, &wq, count);
+	msleep(100); /* allow the waiters to settle into the tree */
+
+	dt = ktime_get();
+	mock_seqno_advance(engine, 1);
+	err = wait_on_atomic_t(&done, wait_atomic_timeout, state);
+	dt = ktime_sub(ktime_get(), dt);
+	if (err) {
+		pr_err("Timed out waiting for %d remaining waiters\n",
+		       atomic_read(&done));
+		goto out_waiters;
 	}
 
+	pr_info("%s: woke %d waiters on a single seqno in %lluus\n",
+		engine->name, count, ktime_to_ns(dt) / NSEC_PER_USEC);
+
+	err = check_rbtree_empty(engine);
+
+out_waiters:
+	igt_wakeup_stop(waiters, count, engine, &wq, &ready, &set, &done);
 	kvfree(waiters);
 out_engines:
 	mock_engine_flush(engine);
@@ -460,6 +540,7 @@ int intel_breadcrumbs_mock_selftests(void)
 		SUBTEST(igt_random_insert_remove),
 		SUBTEST(igt_insert_complete),
 		SUBTEST(igt_wakeup),
+		SUBTEST(igt_wakeup_latency),
 	};
 	struct drm_i915_private *i915;
 	int err;
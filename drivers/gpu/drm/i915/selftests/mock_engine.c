@@ -179,6 +179,8 @@ struct intel_engine_cs *mock_engine(struct drm_i915_private *i915,
 
 	intel_engine_init_breadcrumbs(&engine->base);
 	engine->base.breadcrumbs.mock = true; /* prevent touching HW for irqs */
+	INIT_DELAYED_WORK(&engine->base.retire_work,
+			  i915_gem_engine_retire_work_handler);
 
 	/* fake hw queue */
 	spin_lock_init(&engine->hw_lock);
@@ -220,6 +222,8 @@ void mock_engine_free(struct intel_engine_cs *engine)
 		engine->context_unpin(engine, engine->last_retired_context);
 
 	intel_engine_fini_breadcrumbs(engine);
+	cancel_delayed_work_sync(&engine->retire_work);
+	i915_gem_request_pool_trim(engine);
 
 	kfree(engine->buffer);
 	kfree(engine);
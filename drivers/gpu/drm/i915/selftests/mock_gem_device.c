@@ -61,6 +61,8 @@ static void mock_device_release(struct drm_device *dev)
 	cancel_delayed_work_sync(&i915->gt.idle_work);
 	i915_gem_drain_workqueue(i915);
 
+	i915_gem_request_pools_close(i915);
+
 	mutex_lock(&i915->drm.struct_mutex);
 	for_each_engine(engine, i915, id)
 		mock_engine_free(engine);
@@ -368,11 +368,132 @@ static int igt_sg_trim(void *ignored)
 	return 0;
 }
 
+static int expect_pfn_pages(struct pfn_table *pt, struct page **pages,
+			    const char *who)
+{
+	unsigned long pfn;
+
+	for (pfn = pt->start; pfn < pt->end; pfn++) {
+		struct page *page = pages[pfn - pt->start];
+
+		if (page != pfn_to_page(pfn)) {
+			pr_err("%s: %s left pages out of order, expected pfn %lu, found pfn %lu\n",
+			       __func__, who, pfn, page_to_pfn(page));
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int igt_sg_prime(void *ignored)
+{
+	IGT_TIMEOUT(end_time);
+	const unsigned long max_order = 20; /* approximating a 4GiB object */
+	const npages_fn_t *npages;
+	struct rnd_state prng;
+	unsigned long prime;
+
+	for (npages = npages_funcs; *npages; npages++) {
+		ktime_t to_pages = 0, to_sg = 0;
+		unsigned long total = 0;
+
+		for_each_prime_number(prime, max_order) {
+			unsigned long sz = BIT(prime);
+			struct pfn_table pt, rt;
+			struct sg_table *sgt;
+			struct page **pages;
+			unsigned long count;
+			ktime_t t0, t1;
+			int err;
+
+			prandom_seed_state(&prng, i915_selftest.random_seed);
+			err = alloc_table(&pt, sz, sz, *npages, &prng, -ENOSPC);
+			if (err == -ENOSPC)
+				break;
+			if (err)
+				return err;
+
+			/* keep the page array below ~4GiB worth of pages */
+			count = pt.end - pt.start;
+			if (count > BIT(max_order)) {
+				sg_free_table(&pt.st);
+				break;
+			}
+
+			pages = kvmalloc_array(count, sizeof(*pages),
+					       GFP_KERNEL | __GFP_NOWARN);
+			if (!pages) {
+				sg_free_table(&pt.st);
+				break;
+			}
+
+			t0 = ktime_get();
+			err = drm_prime_sg_to_page_addr_arrays(&pt.st, pages,
+							       NULL, count);
+			t1 = ktime_get();
+			to_pages = ktime_add(to_pages, ktime_sub(t1, t0));
+			if (!err)
+				err = expect_pfn_pages(&pt, pages,
+						       "drm_prime_sg_to_page_addr_arrays");
+			if (err) {
+				err = -EINVAL;
+				goto err_pages;
+			}
+
+			t0 = ktime_get();
+			sgt = drm_prime_pages_to_sg(pages, count);
+			t1 = ktime_get();
+			to_sg = ktime_add(to_sg, ktime_sub(t1, t0));
+			if (IS_ERR(sgt)) {
+				err = PTR_ERR(sgt);
+				if (err == -ENOMEM)
+					err = 0;
+				goto err_pages;
+			}
+
+			/* the pfns are contiguous, so runs must be coalesced */
+			if (sgt->nents > pt.st.nents) {
+				pr_err("drm_prime_pages_to_sg did not coalesce, %u entries for %u source entries\n",
+				       sgt->nents, pt.st.nents);
+				err = -EINVAL;
+			} else {
+				rt.st = *sgt;
+				rt.start = pt.start;
+				rt.end = pt.end;
+				err = expect_pfn_sg_page_iter(&rt,
+							      "drm_prime_pages_to_sg",
+							      end_time);
+			}
+
+			sg_free_table(sgt);
+			kfree(sgt);
+			total += count;
+err_pages:
+			kvfree(pages);
+			sg_free_table(&pt.st);
+			if (err)
+				return err;
+
+			if (igt_timeout(end_time, "%s timed out\n", __func__))
+				break;
+		}
+
+		if (total)
+			pr_info("%s: layout %ld, %lu pages: sg->pages %lluns, pages->sg %lluns\n",
+				__func__, (long)(npages - npages_funcs), total,
+				ktime_to_ns(to_pages), ktime_to_ns(to_sg));
+	}
+
+	return 0;
+}
+
 int scatterlist_mock_selftests(void)
 {
 	static const struct i915_subtest tests[] = {
 		SUBTEST(igt_sg_alloc),
 		SUBTEST(igt_sg_trim),
+		SUBTEST(igt_sg_prime),
 	};
 
 	return i915_subtests(tests, NULL);
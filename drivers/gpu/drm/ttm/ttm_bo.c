@@ -49,6 +49,16 @@ static struct attribute ttm_bo_count = {
 	.mode = S_IRUGO
 };
 
+static struct attribute ttm_bo_eu_backoffs = {
+	.name = "reserve_backoffs",
+	.mode = S_IRUGO
+};
+
+static struct attribute ttm_bo_eu_relocks = {
+	.name = "reserve_relocks",
+	.mode = S_IRUGO
+};
+
 static inline int ttm_mem_type_from_place(const struct ttm_place *place,
 					  uint32_t *mem_type)
 {
@@ -109,12 +119,21 @@ static ssize_t ttm_bo_global_show(struct kobject *kobj,
 	struct ttm_bo_global *glob =
 		container_of(kobj, struct ttm_bo_global, kobj);
 
+	if (attr == &ttm_bo_eu_backoffs)
+		return snprintf(buffer, PAGE_SIZE, "%d\n",
+				atomic_read(&glob->eu_backoffs));
+	if (attr == &ttm_bo_eu_relocks)
+		return snprintf(buffer, PAGE_SIZE, "%d\n",
+				atomic_read(&glob->eu_relocks));
+
 	return snprintf(buffer, PAGE_SIZE, "%d\n",
 				atomic_read(&glob->bo_count));
 }
 
 static struct attribute *ttm_bo_global_attrs[] = {
 	&ttm_bo_count,
+	&ttm_bo_eu_backoffs,
+	&ttm_bo_eu_relocks,
 	NULL
 };
 
@@ -1517,6 +1536,8 @@ int ttm_bo_global_init(struct drm_global_reference *ref)
 		INIT_LIST_HEAD(&glob->swap_lru[i]);
 	INIT_LIST_HEAD(&glob->device_list);
 	atomic_set(&glob->bo_count, 0);
+	atomic_set(&glob->eu_backoffs, 0);
+	atomic_set(&glob->eu_relocks, 0);
 
 	ret = kobject_init_and_add(
 		&glob->kobj, &ttm_bo_glob_kobj_type, ttm_get_kobj(), "buffer_objects");
@@ -31,6 +31,8 @@
 #include <linux/wait.h>
 #include <linux/sched.h>
 #include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/sort.h>
 
 static void ttm_eu_backoff_reservation_reverse(struct list_head *list,
 					      struct ttm_validate_buffer *entry)
@@ -42,6 +44,17 @@ static void ttm_eu_backoff_reservation_reverse(struct list_head *list,
 	}
 }
 
+static unsigned int ttm_eu_count_reserved(struct list_head *list,
+					  struct ttm_validate_buffer *entry)
+{
+	unsigned int count = 0;
+
+	list_for_each_entry_continue_reverse(entry, list, head)
+		count++;
+
+	return count;
+}
+
 static void ttm_eu_del_from_lru_locked(struct list_head *list)
 {
 	struct ttm_validate_buffer *entry;
@@ -137,6 +150,11 @@ int ttm_eu_reserve_buffers(struct ww_acquire_ctx *ticket,
 		 * to only reserve this buffer, then start over if
 		 * this succeeds.
 		 */
+		if (ret == -EDEADLK) {
+			atomic_inc(&glob->eu_backoffs);
+			atomic_add(ttm_eu_count_reserved(list, entry),
+				   &glob->eu_relocks);
+		}
 		ttm_eu_backoff_reservation_reverse(list, entry);
 
 		if (ret == -EDEADLK && intr) {
@@ -176,6 +194,158 @@ int ttm_eu_reserve_buffers(struct ww_acquire_ctx *ticket,
 }
 EXPORT_SYMBOL(ttm_eu_reserve_buffers);
 
+static int ttm_eu_cmp_resv(const void *a, const void *b)
+{
+	const struct ttm_validate_buffer *ea =
+		*(const struct ttm_validate_buffer * const *)a;
+	const struct ttm_validate_buffer *eb =
+		*(const struct ttm_validate_buffer * const *)b;
+
+	if (ea->bo->resv < eb->bo->resv)
+		return -1;
+	return ea->bo->resv > eb->bo->resv;
+}
+
+/*
+ * Reserve buffers in a global (reservation object address) order.
+ *
+ * The locks are taken by walking an array of the entries sorted by
+ * reservation object, so @list keeps the order the caller built it in (e.g.
+ * by validation priority). Submitters sharing many buffers then acquire them
+ * in the same order and rarely wound each other.
+ *
+ * On -EDEADLK every reservation is dropped and the contended buffer is
+ * locked with the slow path. It stays at its place in the sorted order and
+ * is skipped when the walk is restarted, so the order is kept across the
+ * relock.
+ */
+int ttm_eu_reserve_buffers_sorted(struct ww_acquire_ctx *ticket,
+				  struct list_head *list, bool intr,
+				  struct list_head *dups)
+{
+	struct ttm_validate_buffer **order, *entry, *contended = NULL;
+	struct ttm_bo_global *glob;
+	unsigned int count, i, j;
+	int ret;
+
+	/* Without a ticket nothing can be wounded, so order does not matter */
+	if (!ticket || list_empty(list) || list_is_singular(list))
+		return ttm_eu_reserve_buffers(ticket, list, intr, dups);
+
+	count = 0;
+	list_for_each_entry(entry, list, head)
+		count++;
+
+	order = kvmalloc_array(count, sizeof(*order), GFP_KERNEL);
+	if (!order)
+		return ttm_eu_reserve_buffers(ticket, list, intr, dups);
+
+	i = 0;
+	list_for_each_entry(entry, list, head)
+		order[i++] = entry;
+	sort(order, count, sizeof(*order), ttm_eu_cmp_resv, NULL);
+
+	glob = order[0]->bo->glob;
+	ww_acquire_init(ticket, &reservation_ww_class);
+
+retry:
+	for (i = 0; i < count; i++) {
+		struct ttm_buffer_object *bo;
+		unsigned int relocks;
+
+		entry = order[i];
+		if (!entry)
+			continue;
+
+		/* Already reserved with the slow path before the restart */
+		if (entry == contended) {
+			contended = NULL;
+			continue;
+		}
+
+		bo = entry->bo;
+		ret = __ttm_bo_reserve(bo, intr, false, ticket);
+		if (!ret && unlikely(atomic_read(&bo->cpu_writers) > 0)) {
+			reservation_object_unlock(bo->resv);
+
+			ret = -EBUSY;
+		} else if (ret == -EALREADY && dups) {
+			list_move(&entry->head, dups);
+			order[i] = NULL;
+			continue;
+		}
+
+		if (!ret) {
+			if (!entry->shared)
+				continue;
+
+			ret = reservation_object_reserve_shared(bo->resv);
+			if (!ret)
+				continue;
+
+			reservation_object_unlock(bo->resv);
+		}
+
+		/*
+		 * Drop everything we hold: the entries before this one, and
+		 * the contended entry if we have not reached it yet.
+		 */
+		relocks = 0;
+		for (j = 0; j < i; j++) {
+			if (order[j]) {
+				reservation_object_unlock(order[j]->bo->resv);
+				relocks++;
+			}
+		}
+		if (contended) {
+			reservation_object_unlock(contended->bo->resv);
+			contended = NULL;
+			relocks++;
+		}
+
+		if (ret == -EDEADLK) {
+			atomic_inc(&glob->eu_backoffs);
+			atomic_add(relocks, &glob->eu_relocks);
+
+			if (intr) {
+				ret = ww_mutex_lock_slow_interruptible(&bo->resv->lock,
+								       ticket);
+			} else {
+				ww_mutex_lock_slow(&bo->resv->lock, ticket);
+				ret = 0;
+			}
+
+			if (!ret && unlikely(atomic_read(&bo->cpu_writers) > 0))
+				ret = -EBUSY;
+			if (!ret && entry->shared)
+				ret = reservation_object_reserve_shared(bo->resv);
+			if (!ret) {
+				contended = entry;
+				goto retry;
+			}
+
+			if (ret != -EINTR)
+				reservation_object_unlock(bo->resv);
+		}
+
+		if (ret == -EINTR)
+			ret = -ERESTARTSYS;
+		ww_acquire_done(ticket);
+		ww_acquire_fini(ticket);
+		kvfree(order);
+		return ret;
+	}
+
+	ww_acquire_done(ticket);
+	kvfree(order);
+
+	spin_lock(&glob->lru_lock);
+	ttm_eu_del_from_lru_locked(list);
+	spin_unlock(&glob->lru_lock);
+	return 0;
+}
+EXPORT_SYMBOL(ttm_eu_reserve_buffers_sorted);
+
 void ttm_eu_fence_buffer_objects(struct ww_acquire_ctx *ticket,
 				 struct list_head *list,
 				 struct dma_fence *fence)
@@ -187,6 +187,12 @@ struct drm_device {
 	struct idr object_name_idr;
 	struct drm_vma_offset_manager *vma_offset_manager;
 	/*@} */
+
+	/** \name PRIME attachment mapping cache statistics */
+	/*@{ */
+	atomic_t prime_map_hits;	/**< map_dma_buf served from the cache */
+	atomic_t prime_map_misses;	/**< map_dma_buf that built a mapping */
+	/*@} */
 	int switch_power_state;
 
 #ifndef __linux__
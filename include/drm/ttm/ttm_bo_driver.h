@@ -551,6 +551,14 @@ struct ttm_bo_global {
 	 * Internal protection.
 	 */
 	atomic_t bo_count;
+
+	/**
+	 * Reservation contention statistics from ttm_eu_reserve_buffers:
+	 * number of -EDEADLK backoffs and of reservations dropped and
+	 * reacquired because of them.
+	 */
+	atomic_t eu_backoffs;
+	atomic_t eu_relocks;
 };
 
 
@@ -100,6 +100,24 @@ extern int ttm_eu_reserve_buffers(struct ww_acquire_ctx *ticket,
 				  struct list_head *list, bool intr,
 				  struct list_head *dups);
 
+/**
+ * function ttm_eu_reserve_buffers_sorted
+ *
+ * @ticket:  [out] ww_acquire_ctx filled in by call, or NULL if only
+ *           non-blocking reserves should be tried.
+ * @list:    thread private list of ttm_validate_buffer structs.
+ * @intr:    should the wait be interruptible
+ * @dups:    [out] optional list of duplicates.
+ *
+ * Same as ttm_eu_reserve_buffers(), but takes the reservations in
+ * reservation object order, so that concurrent submitters sharing many
+ * buffers rarely need to back off. The order of @list is not changed,
+ * other than duplicates being moved to @dups.
+ */
+extern int ttm_eu_reserve_buffers_sorted(struct ww_acquire_ctx *ticket,
+					 struct list_head *list, bool intr,
+					 struct list_head *dups);
+
 /**
  * function ttm_eu_fence_buffer_objects.
  *
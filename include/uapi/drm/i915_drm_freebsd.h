@@ -0,0 +1,94 @@
+/*-
+ * Copyright (c) 2017 The FreeBSD graphics team
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice unmodified, this list of conditions, and the following
+ *    disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _UAPI_I915_DRM_FREEBSD_H_
+#define _UAPI_I915_DRM_FREEBSD_H_
+
+#include "i915_drm.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Extensions private to this port. i915_drm.h tracks upstream and must not
+ * gain values upstream has not allocated, so anything added here is
+ * numbered from I915_CONTEXT_PARAM_FREEBSD_BASE, well above the range
+ * upstream allocates from.
+ */
+#define I915_CONTEXT_PARAM_FREEBSD_BASE		0x46420000
+
+/*
+ * I915_CONTEXT_PARAM_FREEBSD_RESIDENT_SET:
+ *
+ * value points to an array of struct drm_i915_gem_resident_object and
+ * size is the length of that array in bytes. The objects are bound into
+ * the context's address space and stay pinned there until the set is
+ * replaced, the context is destroyed or their handle is closed; the final
+ * offsets are written back. Every execbuf on the context then includes
+ * them without listing them in buffers_ptr. A size of 0 releases the
+ * current set.
+ *
+ * The new set is bound before the old one is released, and on error the
+ * old set is left in place. To move an object of the current set to a new
+ * EXEC_OBJECT_PINNED offset, release the set first.
+ *
+ * A set holds at most 512 objects, larger sets fail with -E2BIG. On a
+ * context without its own ppgtt the set would be pinned into the global
+ * GTT, so there setting a non-empty set requires CAP_SYS_ADMIN and fails
+ * with -EPERM otherwise.
+ *
+ * getparam reports the number of objects in the set. Userspace probes for
+ * the extension with getparam, which fails with -EINVAL if it is absent.
+ */
+#define I915_CONTEXT_PARAM_FREEBSD_RESIDENT_SET \
+	(I915_CONTEXT_PARAM_FREEBSD_BASE + 0x1)
+
+struct drm_i915_gem_resident_object {
+	/** Handle of the object to keep resident. */
+	__u32 handle;
+
+	/**
+	 * Any of EXEC_OBJECT_WRITE, EXEC_OBJECT_SUPPORTS_48B_ADDRESS,
+	 * EXEC_OBJECT_PINNED and EXEC_OBJECT_ASYNC, with the same meaning as
+	 * for drm_i915_gem_exec_object2.
+	 */
+	__u32 flags;
+
+	/**
+	 * If EXEC_OBJECT_PINNED is set, the requested offset of the object.
+	 * On return, the offset the object is bound at.
+	 */
+	__u64 offset;
+};
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* _UAPI_I915_DRM_FREEBSD_H_ */
@@ -67,6 +67,21 @@ struct reservation_object {
 	struct reservation_object_list *staged;
 };
 
+/*
+ * Cursor for walking the fences of a reservation_object without holding
+ * its lock, see reservation_object_for_each_fence_unlocked().
+ */
+struct reservation_object_iter {
+	struct reservation_object *obj;
+	struct reservation_object_list *fobj;
+	struct dma_fence *fence;
+	unsigned int seq;
+	unsigned int index;
+	unsigned int shared_count;
+	bool all_fences;
+	bool restarted;
+};
+
 #define reservation_object_held(obj) lockdep_is_held(&(obj)->lock.base)
 #define reservation_object_assert_held(obj) \
 	lockdep_assert_held(&(obj)->lock.base)
@@ -179,6 +194,42 @@ int reservation_object_get_fences_rcu(struct reservation_object *obj,
 				      unsigned *pshared_count,
 				      struct dma_fence ***pshared);
 
+struct dma_fence *
+reservation_object_iter_first(struct reservation_object_iter *it);
+struct dma_fence *
+reservation_object_iter_next(struct reservation_object_iter *it);
+
+static inline void
+reservation_object_iter_begin(struct reservation_object_iter *it,
+    struct reservation_object *obj, bool all_fences)
+{
+	it->obj = obj;
+	it->all_fences = all_fences;
+	it->fence = NULL;
+}
+
+static inline void
+reservation_object_iter_end(struct reservation_object_iter *it)
+{
+	dma_fence_put(it->fence);
+	it->fence = NULL;
+}
+
+static inline bool
+reservation_object_iter_is_restarted(struct reservation_object_iter *it)
+{
+	return it->restarted;
+}
+
+/*
+ * Walk all unsignaled fences (or only the exclusive one if !all_fences)
+ * without the reservation lock. The fence is only referenced for the
+ * duration of one loop iteration; take an extra reference to keep it.
+ */
+#define reservation_object_for_each_fence_unlocked(it, fence)		\
+	for ((fence) = reservation_object_iter_first(it); (fence);	\
+	     (fence) = reservation_object_iter_next(it))
+
 int reservation_object_copy_fences(struct reservation_object *dst,
 				   struct reservation_object *src);
 
@@ -43,6 +43,54 @@ EXPORT_SYMBOL(reservation_seqcount_class);
 
 const char reservation_seqcount_string[] = "reservation_seqcount";
 EXPORT_SYMBOL(reservation_seqcount_string);
+/*
+ * Drop all signaled fences from the shared list in place, must be
+ * called with obj->lock held. The surviving fences keep their relative
+ * order; the signaled ones are swapped behind the new shared_count so
+ * that their references can be released after the seqcount write
+ * section without needing a temporary array.
+ */
+static void
+reservation_object_compact_shared(struct reservation_object *obj,
+				  struct reservation_object_list *fobj)
+{
+	struct dma_fence *fence;
+	u32 i, j, count = fobj->shared_count;
+
+	for (i = 0; i < count; ++i) {
+		fence = rcu_dereference_protected(fobj->shared[i],
+						reservation_object_held(obj));
+		if (dma_fence_is_signaled(fence))
+			break;
+	}
+	if (i == count)
+		return;
+
+	preempt_disable();
+	write_seqcount_begin(&obj->seq);
+
+	for (i = j = 0; i < count; ++i) {
+		fence = rcu_dereference_protected(fobj->shared[i],
+						reservation_object_held(obj));
+		if (test_bit(DMA_FENCE_FLAG_SIGNALED_BIT, &fence->flags))
+			continue;
+
+		if (i != j) {
+			RCU_INIT_POINTER(fobj->shared[i], fobj->shared[j]);
+			RCU_INIT_POINTER(fobj->shared[j], fence);
+		}
+		j++;
+	}
+	fobj->shared_count = j;
+
+	write_seqcount_end(&obj->seq);
+	preempt_enable();
+
+	for (i = j; i < count; ++i)
+		dma_fence_put(rcu_dereference_protected(fobj->shared[i],
+						reservation_object_held(obj)));
+}
+
 /*
  * Reserve space to add a shared fence to a reservation_object,
  * must be called with obj->lock held.
@@ -54,6 +102,10 @@ int reservation_object_reserve_shared(struct reservation_object *obj)
 
 	old = reservation_object_get_list(obj);
 
+	/* try to make room by dropping signaled fences before growing */
+	if (old && old->shared_max && old->shared_count == old->shared_max)
+		reservation_object_compact_shared(obj, old);
+
 	if (old && old->shared_max) {
 		if (old->shared_count < old->shared_max) {
 			/* perform an in-place update */
@@ -85,7 +137,8 @@ reservation_object_add_shared_inplace(struct reservation_object *obj,
 				      struct reservation_object_list *fobj,
 				      struct dma_fence *fence)
 {
-	u32 i;
+	struct dma_fence *old_fence, *signaled = NULL;
+	u32 i, signaled_idx = 0;
 
 	dma_fence_get(fence);
 
@@ -93,22 +146,26 @@ reservation_object_add_shared_inplace(struct reservation_object *obj,
 	write_seqcount_begin(&obj->seq);
 
 	for (i = 0; i < fobj->shared_count; ++i) {
-		struct dma_fence *old_fence;
-
 		old_fence = rcu_dereference_protected(fobj->shared[i],
 						reservation_object_held(obj));
 
-		if (old_fence->context == fence->context) {
-			/* memory barrier is added by write_seqcount_begin */
-			RCU_INIT_POINTER(fobj->shared[i], fence);
-			write_seqcount_end(&obj->seq);
-			preempt_enable();
+		if (old_fence->context == fence->context)
+			goto replace;
 
-			dma_fence_put(old_fence);
-			return;
+		if (!signaled &&
+		    test_bit(DMA_FENCE_FLAG_SIGNALED_BIT, &old_fence->flags)) {
+			signaled = old_fence;
+			signaled_idx = i;
 		}
 	}
 
+	/* recycle the slot of a signaled fence instead of growing the list */
+	if (signaled) {
+		old_fence = signaled;
+		i = signaled_idx;
+		goto replace;
+	}
+
 	/*
 	 * memory barrier is added by write_seqcount_begin,
 	 * fobj->shared_count is protected by this lock too
@@ -118,6 +175,15 @@ reservation_object_add_shared_inplace(struct reservation_object *obj,
 
 	write_seqcount_end(&obj->seq);
 	preempt_enable();
+	return;
+
+replace:
+	/* memory barrier is added by write_seqcount_begin */
+	RCU_INIT_POINTER(fobj->shared[i], fence);
+	write_seqcount_end(&obj->seq);
+	preempt_enable();
+
+	dma_fence_put(old_fence);
 }
 
 static void
@@ -126,10 +192,11 @@ reservation_object_add_shared_replace(struct reservation_object *obj,
 				      struct reservation_object_list *fobj,
 				      struct dma_fence *fence)
 {
-	unsigned i;
+	unsigned i, j, k;
 	struct dma_fence *old_fence = NULL;
 
 	dma_fence_get(fence);
+	k = fobj->shared_max;
 
 	if (!old) {
 		RCU_INIT_POINTER(fobj->shared[0], fence);
@@ -142,9 +209,13 @@ reservation_object_add_shared_replace(struct reservation_object *obj,
 	 * requires the use of kref_get_unless_zero, and the
 	 * references from the old struct are carried over to
 	 * the new.
+	 *
+	 * Signaled fences are not carried over: they are parked at the
+	 * tail of the new array (beyond shared_count, which always has
+	 * room for all of old plus one) and released once the new list
+	 * has been published.
 	 */
-	fobj->shared_count = old->shared_count;
-
+	j = 0;
 	for (i = 0; i < old->shared_count; ++i) {
 		struct dma_fence *check;
 
@@ -153,14 +224,16 @@ reservation_object_add_shared_replace(struct reservation_object *obj,
 
 		if (!old_fence && check->context == fence->context) {
 			old_fence = check;
-			RCU_INIT_POINTER(fobj->shared[i], fence);
-		} else
-			RCU_INIT_POINTER(fobj->shared[i], check);
-	}
-	if (!old_fence) {
-		RCU_INIT_POINTER(fobj->shared[fobj->shared_count], fence);
-		fobj->shared_count++;
+			RCU_INIT_POINTER(fobj->shared[j++], fence);
+		} else if (test_bit(DMA_FENCE_FLAG_SIGNALED_BIT,
+				    &check->flags))
+			RCU_INIT_POINTER(fobj->shared[--k], check);
+		else
+			RCU_INIT_POINTER(fobj->shared[j++], check);
 	}
+	if (!old_fence)
+		RCU_INIT_POINTER(fobj->shared[j++], fence);
+	fobj->shared_count = j;
 
 done:
 	preempt_disable();
@@ -178,6 +251,10 @@ done:
 
 	if (old_fence)
 		dma_fence_put(old_fence);
+
+	for (i = k; i < fobj->shared_max; ++i)
+		dma_fence_put(rcu_dereference_protected(fobj->shared[i],
+						reservation_object_held(obj)));
 }
 
 /*
@@ -318,6 +395,87 @@ unlock:
 	return ret;
 }
 
+/*
+ * Lockless, allocation free iteration over the fences of a
+ * reservation_object. Each returned fence carries a reference which is
+ * dropped again when the iterator advances or ends. Already signaled
+ * fences are skipped. If the object is modified while walking, the walk
+ * starts over and reservation_object_iter_is_restarted() reports it so
+ * that callers accumulating state can discard it.
+ */
+static void
+reservation_object_iter_restart(struct reservation_object_iter *it)
+{
+	it->seq = read_seqcount_begin(&it->obj->seq);
+	it->index = -1;
+	it->shared_count = 0;
+	if (it->all_fences) {
+		it->fobj = rcu_dereference(it->obj->fence);
+		if (it->fobj)
+			it->shared_count = it->fobj->shared_count;
+	} else
+		it->fobj = NULL;
+	it->restarted = true;
+}
+
+static void
+reservation_object_iter_walk(struct reservation_object_iter *it)
+{
+	for (;;) {
+		/* drop the reference from the previous round */
+		dma_fence_put(it->fence);
+
+		if (it->index == -1) {
+			it->fence = rcu_dereference(it->obj->fence_excl);
+			it->index++;
+			if (!it->fence)
+				continue;
+		} else if (!it->fobj || it->index >= it->shared_count) {
+			it->fence = NULL;
+			break;
+		} else
+			it->fence = rcu_dereference(it->fobj->shared[it->index++]);
+
+		it->fence = dma_fence_get_rcu(it->fence);
+		if (!it->fence || !dma_fence_is_signaled(it->fence))
+			break;
+	}
+}
+
+struct dma_fence *
+reservation_object_iter_first(struct reservation_object_iter *it)
+{
+	rcu_read_lock();
+	do {
+		reservation_object_iter_restart(it);
+		reservation_object_iter_walk(it);
+	} while (read_seqcount_retry(&it->obj->seq, it->seq));
+	rcu_read_unlock();
+
+	return it->fence;
+}
+EXPORT_SYMBOL(reservation_object_iter_first);
+
+struct dma_fence *
+reservation_object_iter_next(struct reservation_object_iter *it)
+{
+	bool restart;
+
+	rcu_read_lock();
+	it->restarted = false;
+	restart = read_seqcount_retry(&it->obj->seq, it->seq);
+	do {
+		if (restart)
+			reservation_object_iter_restart(it);
+		reservation_object_iter_walk(it);
+		restart = true;
+	} while (read_seqcount_retry(&it->obj->seq, it->seq));
+	rcu_read_unlock();
+
+	return it->fence;
+}
+EXPORT_SYMBOL(reservation_object_iter_next);
+
 int reservation_object_copy_fences(struct reservation_object *dst,
 				   struct reservation_object *src)
 {
@@ -198,12 +198,81 @@ static struct dma_fence **get_fences(struct sync_file *sync_file,
 static void add_fence(struct dma_fence **fences,
 		      int *i, struct dma_fence *fence)
 {
-	fences[*i] = fence;
+	/*
+	 * The array only has room for the fences that were unsignaled when
+	 * counted, so never store a signaled one, not even temporarily.
+	 */
+	if (!dma_fence_is_signaled(fence))
+		fences[(*i)++] = dma_fence_get(fence);
+}
+
+/*
+ * Walk the context ordered fences of @a and @b like sync_file_merge() does
+ * and count how many unsignaled fences the merged sync_file needs. Also
+ * report whether one side already carries every unsignaled fence (or a
+ * later one on the same context) of the other, in which case the merge can
+ * simply share that side's fence.
+ */
+static int sync_file_merge_count(struct dma_fence **a_fences, int a_num_fences,
+				 struct dma_fence **b_fences, int b_num_fences,
+				 bool *a_covers_b, bool *b_covers_a)
+{
+	int num, i_a, i_b;
+
+	*a_covers_b = *b_covers_a = true;
+
+	for (num = i_a = i_b = 0; i_a < a_num_fences && i_b < b_num_fences; ) {
+		struct dma_fence *pt_a = a_fences[i_a];
+		struct dma_fence *pt_b = b_fences[i_b];
+
+		if (pt_a->context < pt_b->context) {
+			if (!dma_fence_is_signaled(pt_a)) {
+				*b_covers_a = false;
+				num++;
+			}
+
+			i_a++;
+		} else if (pt_a->context > pt_b->context) {
+			if (!dma_fence_is_signaled(pt_b)) {
+				*a_covers_b = false;
+				num++;
+			}
+
+			i_b++;
+		} else {
+			bool a_signaled = dma_fence_is_signaled(pt_a);
+			bool b_signaled = dma_fence_is_signaled(pt_b);
+
+			if (pt_a->seqno - pt_b->seqno <= INT_MAX) {
+				if (!a_signaled && pt_a->seqno != pt_b->seqno)
+					*b_covers_a = false;
+				num += !a_signaled;
+			} else {
+				if (!b_signaled)
+					*a_covers_b = false;
+				num += !b_signaled;
+			}
 
-	if (!dma_fence_is_signaled(fence)) {
-		dma_fence_get(fence);
-		(*i)++;
+			i_a++;
+			i_b++;
+		}
 	}
+
+	for (; i_a < a_num_fences; i_a++) {
+		if (!dma_fence_is_signaled(a_fences[i_a])) {
+			*b_covers_a = false;
+			num++;
+		}
+	}
+
+	for (; i_b < b_num_fences; i_b++) {
+		if (!dma_fence_is_signaled(b_fences[i_b])) {
+			*a_covers_b = false;
+			num++;
+		}
+	}
+
+	return num;
 }
 
 /**
@@ -215,13 +284,19 @@ static void add_fence(struct dma_fence **fences,
  * Creates a new sync_file which contains copies of all the fences in both
  * @a and @b.  @a and @b remain valid, independent sync_file. Returns the
  * new merged sync_file or NULL in case of error.
+ *
+ * Signaled fences are dropped and only the latest fence per context is
+ * kept. If all pending fences of one side are already represented in the
+ * other, the new sync_file shares the fence (or fence array) of that side
+ * instead of building a new dma_fence_array.
  */
 static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 					 struct sync_file *b)
 {
 	struct sync_file *sync_file;
-	struct dma_fence **fences, **nfences, **a_fences, **b_fences;
+	struct dma_fence **fences, **a_fences, **b_fences;
 	int i, i_a, i_b, num_fences, a_num_fences, b_num_fences;
+	bool a_covers_b, b_covers_a;
 
 	sync_file = sync_file_alloc();
 	if (!sync_file)
@@ -230,12 +305,6 @@ static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 	a_fences = get_fences(a, &a_num_fences);
 	b_fences = get_fences(b, &b_num_fences);
 	if (a_num_fences > INT_MAX - b_num_fences)
-		return NULL;
-
-	num_fences = a_num_fences + b_num_fences;
-
-	fences = kcalloc(num_fences, sizeof(*fences), GFP_KERNEL);
-	if (!fences)
 		goto err;
 
 	/*
@@ -245,6 +314,21 @@ static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 	 * If a sync_file can only be created with sync_file_merge
 	 * and sync_file_create, this is a reasonable assumption.
 	 */
+	num_fences = sync_file_merge_count(a_fences, a_num_fences,
+					   b_fences, b_num_fences,
+					   &a_covers_b, &b_covers_a);
+
+	if (a_covers_b || b_covers_a) {
+		sync_file->fence = dma_fence_get(a_covers_b ?
+						 a->fence : b->fence);
+		goto out;
+	}
+
+	/* Keep a slot for the fallback fence below should all have signaled */
+	fences = kcalloc(max(num_fences, 1), sizeof(*fences), GFP_KERNEL);
+	if (!fences)
+		goto err;
+
 	for (i = i_a = i_b = 0; i_a < a_num_fences && i_b < b_num_fences; ) {
 		struct dma_fence *pt_a = a_fences[i_a];
 		struct dma_fence *pt_b = b_fences[i_b];
@@ -274,23 +358,21 @@ static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 	for (; i_b < b_num_fences; i_b++)
 		add_fence(fences, &i, b_fences[i_b]);
 
+	/*
+	 * Fences only ever become signaled, so i <= num_fences. If some
+	 * signaled since they were counted, the array is merely oversized.
+	 */
 	if (i == 0)
 		fences[i++] = dma_fence_get(a_fences[0]);
 
-	if (num_fences > i) {
-		nfences = krealloc(fences, i * sizeof(*fences),
-				  GFP_KERNEL);
-		if (!nfences)
-			goto err;
-
-		fences = nfences;
-	}
-
 	if (sync_file_set_fence(sync_file, fences, i) < 0) {
+		for (i_a = 0; i_a < i; i_a++)
+			dma_fence_put(fences[i_a]);
 		kfree(fences);
 		goto err;
 	}
 
+out:
 	strlcpy(sync_file->user_name, name, sizeof(sync_file->user_name));
 	return sync_file;
 